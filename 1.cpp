@@ -4,54 +4,44 @@
 #include <vector>
 #include <cmath>
 #include <ctime>
-#include <iomanip>
-#include <sstream>
+#include <cstdio>
+#include "replay.hpp"
+#include "frontend.hpp"
+#include "hud.hpp"
+#include "engage.hpp"
+#include "alloc.hpp"
+#include "journal.hpp"
 
 using namespace cv;
 using namespace std;
 
-string getCurrentTime() {
-    time_t now = time(0);
-    tm *ltm = localtime(&now);
-    stringstream ss;
-    ss << setw(2) << setfill('0') << ltm->tm_hour << ":"
-       << setw(2) << setfill('0') << ltm->tm_min << ":"
-       << setw(2) << setfill('0') << ltm->tm_sec;
-    return ss.str();
-}
-
-void drawBracket(Mat& img, int x, int y, int w, int h, Scalar color) {
-    int len = w / 4;
-    line(img, Point(x, y), Point(x + len, y), color, 2);
-    line(img, Point(x, y), Point(x, y + len), color, 2);
-    line(img, Point(x + w, y), Point(x + w - len, y), color, 2);
-    line(img, Point(x + w, y), Point(x + w, y + len), color, 2);
-    line(img, Point(x, y + h), Point(x + len, y + h), color, 2);
-    line(img, Point(x, y + h), Point(x, y + h - len), color, 2);
-    line(img, Point(x + w, y + h), Point(x + w - len, y + h), color, 2);
-    line(img, Point(x + w, y + h), Point(x + w, y + h - len), color, 2);
-}
-
 // دالة لرسم الانفجار
-void drawExplosion(Mat& img, Point center, int frameState) {
+void drawExplosion(HudCompositor& hud, Point center, int frameState) {
     Scalar color1(0, 255, 255); // أصفر
     Scalar color2(0, 0, 255);   // أحمر
 
     int radius = frameState * 15;
 
     // دائرة خارجية حمراء
-    circle(img, center, radius, color2, 4);
+    hud.circle(center, radius, color2, 4);
     // دائرة داخلية صفراء (كرة النار)
-    circle(img, center, radius / 2, color1, FILLED);
+    hud.circle(center, radius / 2, color1, FILLED);
 
     // شظايا
-    line(img, center, Point(center.x + radius + 10, center.y + radius + 10), color1, 2);
-    line(img, center, Point(center.x - radius - 10, center.y - radius - 10), color1, 2);
-    line(img, center, Point(center.x + radius + 10, center.y - radius - 10), color1, 2);
-    line(img, center, Point(center.x - radius - 10, center.y + radius + 10), color1, 2);
+    hud.line(center, Point(center.x + radius + 10, center.y + radius + 10), color1, 2);
+    hud.line(center, Point(center.x - radius - 10, center.y - radius - 10), color1, 2);
+    hud.line(center, Point(center.x + radius + 10, center.y - radius - 10), color1, 2);
+    hud.line(center, Point(center.x - radius - 10, center.y + radius + 10), color1, 2);
 }
 
-int main() {
+int main(int argc, char** argv) {
+    ReplayOptions opt = parseReplayArgs(argc, argv);
+    if (opt.headless) {
+        DetectorConfig cfg;
+        cfg.condition.size = Size(1024, 600);
+        return runReplay(opt, cfg);
+    }
+
     VideoCapture cap(1); // تأكد من رقم الكاميرا
     if (!cap.isOpened()) return -1;
 
@@ -61,197 +51,220 @@ int main() {
     Scalar white(200, 200, 200);
     Scalar yellow(0, 255, 255); // لون الصاروخ
 
-    Scalar lowerBlue(100, 150, 0);
-    Scalar upperBlue(140, 255, 255);
-
-    Mat frame, hsv, mask, display;
+    // Colour classes, capture, detection and tracks (frontend.hpp)
+    TargetFrontEnd frontEnd(opt);
+    const ColorClassifier& classifier = frontEnd.classifier();
     int radarSweep = 0;
     int counter = 0;
 
-    // متغيرات الصاروخ
-    bool missileActive = false;
-    Point missilePos;
-    bool explosionActive = false;
-    int explosionTimer = 0;
-
-    vector<string> logData;
-    logData.push_back("SYS_INIT... OK");
-    logData.push_back("RADAR_M... ACTIVE");
-    logData.push_back("LINK_16... SECURE");
+    // الانفجارات الظاهرة على الشاشة
+    struct Explosion { Point pos; int timer; };
+    vector<Explosion> explosions;
+    explosions.reserve(16);
+    bool announceEngage = false;
+
+    // Event log above, live stage timings (telemetry.hpp) below it
+    LogRing<6> logData;
+    logData.push("SYS_INIT... OK");
+    logData.push("RADAR_M... ACTIVE");
+    logData.push("LINK_16... SECURE");
+
+    // Capture and detection run on their own threads; this thread only draws
+    FramePipeline<Detected> pipeline([&](FramePacket& p) { return frontEnd.capture(cap, p); },
+                                     [&](FramePacket& in, Detected& out) { frontEnd.detect(in, out); });
+
+    // Everything that never changes is drawn once into the static HUD layer;
+    // the render loop only draws the moving parts.
+    HudLayout layout(frontEnd.size());
+    HudCompositor hud(layout.size);
+    hud.buildStatic([&](Mat& layer) {
+        // the launcher boxes change when fired, so they are drawn per frame
+        drawStaticHud(layer, layout, cyan, white, red);
+    });
+
+    // Every font the loop uses, so no glyph is rasterized mid-run
+    hud.preloadFont(FONT_HERSHEY_PLAIN, 0.9);
+    hud.preloadFont(FONT_HERSHEY_PLAIN, 1);
+    hud.preloadFont(FONT_HERSHEY_SIMPLEX, 0.6);
+    hud.preloadFont(FONT_HERSHEY_SIMPLEX, 0.7);
+    hud.preloadFont(FONT_HERSHEY_SIMPLEX, 0.8, 2);
+    hud.preloadFont(FONT_HERSHEY_SIMPLEX, 0.6, 2);
+    hud.preloadFont(FONT_HERSHEY_SIMPLEX, 0.7, 2);
+
+    // Interceptors fly on a fixed timestep of their own; one launcher per weapon box
+    EngagementConfig ec;
+    for (int i = 0; i < 4; i++) ec.launchers.push_back(Point2f(350 + i*110, layout.botY));
+    uint64_t seed = (uint64_t)time(0);
+    EngagementEngine engine(ec, seed);
+    logData.push("SEED %llu", (unsigned long long)seed);
+    int64 lastTick = getTickCount();
 
     namedWindow("EGY_ADS_V2", WINDOW_NORMAL);
     resizeWindow("EGY_ADS_V2", 1280, 720);
+    // Steady state draws from preallocated buffers only; debug builds check it
+    FrameAllocCheck allocCheck;
+    char text[64];
+    TelemetryPanel telemetry;
+    TelemetryWriter telemetryLog(opt.telemetryPath);
+    // --journal: one binary record per frame for after-action review (journal tool)
+    JournalWriter journal;
+    JournalRecord record;
+    frontEnd.openJournal(journal, seed);
+    pipeline.start();
 
     while (true) {
-        cap >> frame;
-        if (frame.empty()) break;
-        flip(frame, frame, 1);
-        resize(frame, frame, Size(1024, 600));
-
-        display = frame.clone();
-
-        // Darken background
-        Mat overlay;
-        display.copyTo(overlay);
-        rectangle(overlay, Point(0,0), Point(display.cols, display.rows), Scalar(0,20,0), FILLED);
-        addWeighted(overlay, 0.3, display, 0.7, 0, display);
-
-        // Scanlines
-        for(int y=0; y<display.rows; y+=4) {
-            line(display, Point(0, y), Point(display.cols, y), Scalar(0,0,0), 1);
+        Detected* d = pipeline.next(chrono::milliseconds(100));
+        if (!d) {
+            if (pipeline.finished() || pollKey() == 27) break;
+            continue;
         }
-
-        cvtColor(frame, hsv, COLOR_BGR2HSV);
-        inRange(hsv, lowerBlue, upperBlue, mask);
-
-        vector<vector<Point>> contours;
-        findContours(mask, contours, RETR_EXTERNAL, CHAIN_APPROX_SIMPLE);
-
-        bool locked = false;
-        Rect targetBox;
-        Point center;
-
-        if (!contours.empty()) {
-            double maxArea = 0; int idx = -1;
-            for (int i=0; i<contours.size(); i++) {
-                double a = contourArea(contours[i]);
-                if (a > maxArea) { maxArea = a; idx = i; }
-            }
-            if (idx != -1 && maxArea > 400) {
-                locked = true;
-                targetBox = boundingRect(contours[idx]);
-                center = Point(targetBox.x + targetBox.width/2, targetBox.y + targetBox.height/2);
-            }
+        allocCheck.begin();
+        ADS_TIME_STAGE(FRAME);
+        ADS_LAPS(frameLaps);
+        ADS_COUNT(FRAMES, 1);
+        Mat& display = d->display;
+
+        const Track* target = d->engaged >= 0 ? &d->tracks[d->engaged] : nullptr;
+        bool locked = target != nullptr;
+        Rect targetBox = locked ? target->box : Rect();
+        Point center = locked ? target->center() : Point();
+        if (announceEngage && locked) {
+            logData.push("ENGAGE T%d", target->id);
+            announceEngage = false;
         }
 
         // --- LEFT SIDE DATA ---
-        int leftX = 20;
-        putText(display, "UNIT: 777-AGR", Point(leftX, 40), FONT_HERSHEY_SIMPLEX, 0.6, cyan, 1);
-        putText(display, "SEC: CAIRO_N", Point(leftX, 65), FONT_HERSHEY_SIMPLEX, 0.6, cyan, 1);
-        putText(display, "LAT: 30.0444 N", Point(leftX, 90), FONT_HERSHEY_SIMPLEX, 0.5, white, 1);
-        putText(display, "LON: 31.2357 E", Point(leftX, 110), FONT_HERSHEY_SIMPLEX, 0.5, white, 1);
-
-        rectangle(display, Point(leftX, 130), Point(leftX+150, 400), cyan, 1);
-        putText(display, "SYSTEM LOG", Point(leftX+5, 145), FONT_HERSHEY_PLAIN, 1, cyan, 1);
-
-        if (counter % 50 == 0) {
-            stringstream ss; ss << "PING: " << rand()%90 + 10 << "ms";
-            logData.push_back(ss.str());
-            if (logData.size() > 10) logData.erase(logData.begin());
-        }
         for(int i=0; i<logData.size(); i++) {
-            putText(display, logData[i], Point(leftX+5, 170 + i*20), FONT_HERSHEY_PLAIN, 0.9, white, 1);
+            hud.text(logData[i], Point(layout.leftX+5, 170 + i*20), FONT_HERSHEY_PLAIN, 0.9, white, 1);
         }
+        // Live stage timings (telemetry.hpp) under the event log
+        telemetry.draw(hud, layout, cyan);
 
         // --- RIGHT SIDE DATA ---
-        int rightX = display.cols - 180;
-        putText(display, "WIND: 12 KTS", Point(rightX, 40), FONT_HERSHEY_PLAIN, 1, cyan, 1);
-        putText(display, "VIS: 10 KM", Point(rightX, 60), FONT_HERSHEY_PLAIN, 1, cyan, 1);
-        putText(display, "TEMP: 34 C", Point(rightX, 80), FONT_HERSHEY_PLAIN, 1, cyan, 1);
-
-        // Altitude Tape
-        line(display, Point(rightX-20, 100), Point(rightX-20, 400), cyan, 2);
-        for(int i=0; i<10; i++) {
-            line(display, Point(rightX-20, 120 + i*30), Point(rightX-10, 120 + i*30), cyan, 1);
-            putText(display, to_string(1000 - i*100), Point(rightX, 125 + i*30), FONT_HERSHEY_PLAIN, 0.8, white, 1);
-        }
+        PipelineStats stats = pipeline.stats();
+        snprintf(text, sizeof(text), "DROP CAP:%lld DET:%lld", (long long)stats.captureDropped, (long long)stats.detectDropped);
+        hud.text(text, Point(layout.rightX - 40, display.rows - 20), FONT_HERSHEY_PLAIN, 1, white, 1);
+
+        // Altitude marker
         int altY = 400 - (center.y * 300 / display.rows);
         if(!locked) altY = 250;
-        line(display, Point(rightX-25, altY), Point(rightX-5, altY), red, 2);
-        putText(display, "ALT", Point(rightX-45, altY+5), FONT_HERSHEY_PLAIN, 1, red, 1);
+        hud.line(Point(layout.rightX-25, altY), Point(layout.rightX-5, altY), red, 2);
+        hud.text("ALT", Point(layout.rightX-45, altY+5), FONT_HERSHEY_PLAIN, 1, red, 1);
 
         // --- TOP BAR ---
-        rectangle(display, Point(300, 10), Point(724, 50), Scalar(0, 50, 0), FILLED);
-        line(display, Point(512, 10), Point(512, 60), red, 2);
-        putText(display, getCurrentTime(), Point(display.cols/2 - 50, 80), FONT_HERSHEY_SIMPLEX, 0.6, cyan, 1);
+        getCurrentTime(text, sizeof(text));
+        hud.text(text, Point(display.cols/2 - 50, 80), FONT_HERSHEY_SIMPLEX, 0.6, cyan, 1);
 
         // --- BOTTOM BAR (WEAPONS) ---
-        int botY = display.rows - 60;
-        for(int i=0; i<4; i++) {
-            Scalar wpnColor = cyan;
-            string wpnText = "RDY";
-            // لو الصاروخ انضرب، نغير لون أول مربع
-            if (missileActive || explosionActive) {
-                if (i==0) { wpnColor = red; wpnText = "EMPTY"; }
-            }
-
-            rectangle(display, Point(300 + i*110, botY), Point(400 + i*110, botY+40), wpnColor, 1);
-            putText(display, "M-" + to_string(i+1), Point(310 + i*110, botY+25), FONT_HERSHEY_PLAIN, 1, white, 1);
-            putText(display, wpnText, Point(360 + i*110, botY+25), FONT_HERSHEY_PLAIN, 1, (i==0 && (missileActive||explosionActive)) ? red : green, 1);
+        // المنصة الفاضية لونها أحمر لحد ما تتعمر
+        for (int i = 0; i < engine.launcherCount(); i++) {
+            bool empty = engine.rounds(i) == 0;
+            hud.rectangle(Point(300 + i*110, layout.botY), Point(400 + i*110, layout.botY+40), empty ? red : cyan, 1);
+            hud.text(empty ? "EMPTY" : "RDY", Point(360 + i*110, layout.botY+25), FONT_HERSHEY_PLAIN, 1, empty ? red : green, 1);
         }
 
-        // --- RADAR CIRCLE ---
-        int radX = 100, radY = display.rows - 100;
-        circle(display, Point(radX, radY), 70, Scalar(0,100,0), 1);
+        // --- RADAR SWEEP ---
         radarSweep = (radarSweep + 5) % 360;
         float ang = radarSweep * CV_PI / 180;
-        line(display, Point(radX, radY), Point(radX + 70*cos(ang), radY + 70*sin(ang)), green, 2);
-
-        // --- CENTER HUD & MISSILE LOGIC ---
-        Point screenCenter(display.cols/2, display.rows/2);
-        line(display, Point(screenCenter.x-20, screenCenter.y), Point(screenCenter.x+20, screenCenter.y), cyan, 1);
-        line(display, Point(screenCenter.x, screenCenter.y-20), Point(screenCenter.x, screenCenter.y+20), cyan, 1);
-
-        // 1. منطق الصاروخ (Movement Logic)
-        if (missileActive && locked) {
-            // حساب المسافة والاتجاه للهدف
-            Point diff = center - missilePos;
-            double dist = norm(diff);
-
-            // سرعة الصاروخ (كل ما الرقم زاد كل ما بقى أسرع)
-            missilePos += diff * 0.15;
-
-            // رسم الصاروخ (كرة صفراء) وذيل دخان
-            line(display, Point(display.cols/2, display.rows), missilePos, Scalar(100,100,100), 1); // ذيل دخان
-            circle(display, missilePos, 5, yellow, FILLED);
-            putText(display, ">> MISSILE AWAY >>", Point(display.cols/2 - 80, display.rows/2 + 150), FONT_HERSHEY_SIMPLEX, 0.6, red, 2);
-
-            // لو قربنا من الهدف (Impact)
-            if (dist < 20) {
-                missileActive = false;
-                explosionActive = true;
-                explosionTimer = 0;
-                logData.push_back("TARGET HIT!!");
+        hud.line(Point(layout.radX, layout.radY), Point(layout.radX + 70*cos(ang), layout.radY + 70*sin(ang)), green, 2);
+
+        // --- MISSILE LOGIC ---
+        // 1. منطق الصواريخ: المحرك بيتحرك بخطوة زمنية ثابتة مهما كان معدل الإطارات
+        for (const Track& t : d->tracks) {
+            if (t.visible()) engine.observe(t.id, Point2f(t.center()));
+        }
+        int64 tick = getTickCount();
+        engine.advance((tick - lastTick) / getTickFrequency());
+        lastTick = tick;
+        for (const EngageEvent& e : engine.events()) {
+            switch (e.type) {
+            case EngageEvent::LAUNCH: logData.push("M-%d LAUNCH > T%d", e.launcher + 1, e.target); break;
+            case EngageEvent::HIT:
+                logData.push("TARGET HIT!! T%d", e.target);
+                if (explosions.size() < explosions.capacity()) explosions.push_back({Point(e.pos), 0});
+                break;
+            case EngageEvent::MISS: logData.push("M-%d MISSED T%d", e.launcher + 1, e.target); break;
+            case EngageEvent::LOST: logData.push("MISSILE LOST"); break;
+            case EngageEvent::RELOADED: logData.push("M-%d RELOADED", e.launcher + 1); break;
             }
         }
+        if (journal.isOpen()) {
+            record.fill(d->tracks, locked ? target->id : -1, &engine);
+            journal.append(record);
+        }
+        engine.clearEvents();
+
+        // رسم الصواريخ (كرة صفراء) وذيل دخان من المنصة
+        const InterceptorArrays& in = engine.interceptors();
+        for (int i = 0; i < in.size(); i++) {
+            Point pos(cvRound(in.x[i]), cvRound(in.y[i]));
+            hud.line(Point(engine.launcherPos(in.launcher[i])), pos, Scalar(100,100,100), 1); // ذيل دخان
+            hud.circle(pos, 5, yellow, FILLED);
+        }
+        if (in.size() > 0)
+            hud.text(">> MISSILE AWAY >>", Point(display.cols/2 - 80, display.rows/2 + 150), FONT_HERSHEY_SIMPLEX, 0.6, red, 2);
 
         // 2. منطق الانفجار (Explosion Logic)
-        if (explosionActive) {
-            drawExplosion(display, center, explosionTimer);
-            putText(display, "!! IMPACT CONFIRMED !!", Point(center.x - 100, center.y - 50), FONT_HERSHEY_SIMPLEX, 0.7, red, 2);
-            explosionTimer++;
-            if (explosionTimer > 10) explosionActive = false; // الانفجار بيختفي بعد شوية
+        for (size_t i = 0; i < explosions.size();) {
+            Explosion& x = explosions[i];
+            drawExplosion(hud, x.pos, x.timer);
+            hud.text("!! IMPACT CONFIRMED !!", Point(x.pos.x - 100, x.pos.y - 50), FONT_HERSHEY_SIMPLEX, 0.7, red, 2);
+            // الانفجار بيختفي بعد شوية
+            if (++x.timer > 10) explosions.erase(explosions.begin() + i);
+            else i++;
+        }
+
+        // Every track other than the engaged one
+        for (const Track& t : d->tracks) {
+            if (!t.visible() || &t == target) continue;
+            hud.bracket(t.box.x-10, t.box.y-10, t.box.width+20, t.box.height+20, white);
+            snprintf(text, sizeof(text), "T%d %s", t.id, classifier.name(t.cls).c_str());
+            hud.text(text, Point(t.box.x, t.box.y-20), FONT_HERSHEY_PLAIN, 1, white, 1);
+            snprintf(text, sizeof(text), "RNG: %d M", 50000 / max(t.box.width, 1));
+            hud.text(text, Point(t.box.x + t.box.width + 10, t.box.y + 20), FONT_HERSHEY_PLAIN, 1, white, 1);
         }
 
         if (locked) {
-            if (!explosionActive) { // عشان ميغطيش على الانفجار
-                drawBracket(display, targetBox.x-10, targetBox.y-10, targetBox.width+20, targetBox.height+20, red);
-                circle(display, center, 5, red, FILLED);
-                putText(display, "LOCK", Point(targetBox.x, targetBox.y-20), FONT_HERSHEY_SIMPLEX, 0.8, red, 2);
+            if (explosions.empty()) { // عشان ميغطيش على الانفجار
+                hud.bracket(targetBox.x-10, targetBox.y-10, targetBox.width+20, targetBox.height+20, red);
+                hud.circle(center, 5, red, FILLED);
+                snprintf(text, sizeof(text), "LOCK T%d %s", target->id, classifier.name(target->cls).c_str());
+                hud.text(text, Point(targetBox.x, targetBox.y-20), FONT_HERSHEY_SIMPLEX, 0.8, red, 2);
+                snprintf(text, sizeof(text), "RNG: %d M", 50000 / max(targetBox.width, 1));
+                hud.text(text, Point(targetBox.x + targetBox.width + 10, targetBox.y + 20), FONT_HERSHEY_PLAIN, 1, red, 1);
             }
         } else {
-            // لو اللوك ضاع والطاروخ في الجو، الصاروخ يضيع
-            if (missileActive) { missileActive = false; logData.push_back("MISSILE LOST"); }
-
-            drawBracket(display, screenCenter.x-100, screenCenter.y-100, 200, 200, white);
-            if(counter % 40 < 20) putText(display, "NO TARGET", Point(screenCenter.x-60, screenCenter.y+130), FONT_HERSHEY_SIMPLEX, 0.7, red, 1);
+            hud.bracket(layout.center.x-100, layout.center.y-100, 200, 200, white);
+            if(counter % 40 < 20) hud.text("NO TARGET", Point(layout.center.x-60, layout.center.y+130), FONT_HERSHEY_SIMPLEX, 0.7, red, 1);
         }
 
+        hud.compose(display);
+        ADS_LAP(frameLaps, HUD);
+        allocCheck.end();
         imshow("EGY_ADS_V2", display);
+        ADS_LAP(frameLaps, IMSHOW);
         counter++;
 
         // --- INPUT HANDLING ---
-        int key = waitKey(30);
+        // No fixed sleep: the next frame is drawn as soon as detection delivers it
+        int key = pollKey();
         if (key == 27) break; // ESC to exit
 
+        // TAB cycles the engaged track
+        if (key == 9) {
+            frontEnd.cycleEngaged();
+            announceEngage = true;
+        }
+
         // زرار المسافة (SPACE) لإطلاق الصاروخ
-        if (key == 32 && locked && !missileActive && !explosionActive) {
-            missileActive = true;
-            // الصاروخ بينطلق من تحت في النص
-            missilePos = Point(display.cols/2, display.rows);
-            logData.push_back("LAUNCH DETECTED!");
+        // كل ضغطة بتطلق صاروخ من أول منصة جاهزة على الهدف المقفول عليه
+        if (key == 32 && locked && engine.launch(target->id) < 0) {
+            logData.push("NO LAUNCHER READY");
         }
     }
+    pipeline.stop();
+    journal.close();
+    frontEnd.printSummary(pipeline.stats());
     cap.release();
     destroyAllWindows();
     return 0;
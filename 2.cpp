@@ -4,35 +4,24 @@
 #include <vector>
 #include <cmath>
 #include <ctime>
-#include <iomanip>
-#include <sstream>
+#include <cstdio>
+#include "replay.hpp"
+#include "frontend.hpp"
+#include "hud.hpp"
+#include "alloc.hpp"
+#include "journal.hpp"
 
 using namespace cv;
 using namespace std;
 
-string getCurrentTime() {
-    time_t now = time(0);
-    tm *ltm = localtime(&now);
-    stringstream ss;
-    ss << setw(2) << setfill('0') << ltm->tm_hour << ":"
-       << setw(2) << setfill('0') << ltm->tm_min << ":"
-       << setw(2) << setfill('0') << ltm->tm_sec;
-    return ss.str();
-}
-
-void drawBracket(Mat& img, int x, int y, int w, int h, Scalar color) {
-    int len = w / 4;
-    line(img, Point(x, y), Point(x + len, y), color, 2);
-    line(img, Point(x, y), Point(x, y + len), color, 2);
-    line(img, Point(x + w, y), Point(x + w - len, y), color, 2);
-    line(img, Point(x + w, y), Point(x + w, y + len), color, 2);
-    line(img, Point(x, y + h), Point(x + len, y + h), color, 2);
-    line(img, Point(x, y + h), Point(x, y + h - len), color, 2);
-    line(img, Point(x + w, y + h), Point(x + w - len, y + h), color, 2);
-    line(img, Point(x + w, y + h), Point(x + w, y + h - len), color, 2);
-}
+int main(int argc, char** argv) {
+    ReplayOptions opt = parseReplayArgs(argc, argv);
+    if (opt.headless) {
+        DetectorConfig cfg;
+        cfg.condition.size = Size(1024, 600);
+        return runReplay(opt, cfg);
+    }
 
-int main() {
     VideoCapture cap(1);
     if (!cap.isOpened()) return -1;
 
@@ -41,141 +30,155 @@ int main() {
     Scalar green(0, 255, 0);
     Scalar white(200, 200, 200);
 
-    Scalar lowerBlue(100, 150, 0);
-    Scalar upperBlue(140, 255, 255);
-
-    Mat frame, hsv, mask, display;
+    // Colour classes, capture, detection and tracks (frontend.hpp)
+    TargetFrontEnd frontEnd(opt);
+    const ColorClassifier& classifier = frontEnd.classifier();
     int radarSweep = 0;
     int counter = 0;
-
-    vector<string> logData;
-    logData.push_back("SYS_INIT... OK");
-    logData.push_back("RADAR_M... ACTIVE");
-    logData.push_back("LINK_16... SECURE");
-
+    bool announceEngage = false;
+
+    // Event log above, live stage timings (telemetry.hpp) below it
+    LogRing<6> logData;
+    logData.push("SYS_INIT... OK");
+    logData.push("RADAR_M... ACTIVE");
+    logData.push("LINK_16... SECURE");
+
+    FramePipeline<Detected> pipeline([&](FramePacket& p) { return frontEnd.capture(cap, p); },
+                                     [&](FramePacket& in, Detected& out) { frontEnd.detect(in, out); });
+
+    // Everything that never changes is drawn once into the static HUD layer.
+    HudLayout layout(frontEnd.size());
+    HudCompositor hud(layout.size);
+    hud.buildStatic([&](Mat& layer) {
+        drawStaticHud(layer, layout, cyan, white, red);
+        Scalar c = HudCompositor::opaque(cyan), g = HudCompositor::opaque(green);
+        for(int i=0; i<4; i++) {
+            rectangle(layer, Point(300 + i*110, layout.botY), Point(400 + i*110, layout.botY+40), c, 1);
+            putText(layer, "RDY", Point(360 + i*110, layout.botY+25), FONT_HERSHEY_PLAIN, 1, g, 1);
+        }
+        putText(layer, "RADAR: ON", Point(layout.radX-35, layout.radY+90), FONT_HERSHEY_PLAIN, 1, c, 1);
+    });
+
+    // Every font the loop uses, so no glyph is rasterized mid-run
+    hud.preloadFont(FONT_HERSHEY_PLAIN, 0.9);
+    hud.preloadFont(FONT_HERSHEY_PLAIN, 1);
+    hud.preloadFont(FONT_HERSHEY_SIMPLEX, 0.6);
+    hud.preloadFont(FONT_HERSHEY_SIMPLEX, 0.7);
+    hud.preloadFont(FONT_HERSHEY_SIMPLEX, 0.8, 2);
     namedWindow("EGY_ADS_V2", WINDOW_NORMAL);
     resizeWindow("EGY_ADS_V2", 1280, 720);
+    // Steady state draws from preallocated buffers only; debug builds check it
+    FrameAllocCheck allocCheck;
+    char text[64];
+    TelemetryPanel telemetry;
+    TelemetryWriter telemetryLog(opt.telemetryPath);
+    // --journal: one binary record per frame for after-action review (journal tool)
+    // 2 flies no interceptors: seed 0 and no engagement events
+    JournalWriter journal;
+    JournalRecord record;
+    frontEnd.openJournal(journal, 0);
+    pipeline.start();
 
     while (true) {
-        cap >> frame;
-        if (frame.empty()) break;
-        flip(frame, frame, 1);
-        resize(frame, frame, Size(1024, 600));
-
-        display = frame.clone();
-
-        Mat overlay;
-        display.copyTo(overlay);
-        rectangle(overlay, Point(0,0), Point(display.cols, display.rows), Scalar(0,20,0), FILLED);
-        addWeighted(overlay, 0.3, display, 0.7, 0, display);
-
-        for(int y=0; y<display.rows; y+=4) {
-            line(display, Point(0, y), Point(display.cols, y), Scalar(0,0,0), 1);
+        Detected* d = pipeline.next(chrono::milliseconds(100));
+        if (!d) {
+            if (pipeline.finished() || pollKey() == 27) break;
+            continue;
         }
-
-        cvtColor(frame, hsv, COLOR_BGR2HSV);
-        inRange(hsv, lowerBlue, upperBlue, mask);
-
-        vector<vector<Point>> contours;
-        findContours(mask, contours, RETR_EXTERNAL, CHAIN_APPROX_SIMPLE);
-
-        bool locked = false;
-        Rect targetBox;
-        Point center;
-
-        if (!contours.empty()) {
-            double maxArea = 0; int idx = -1;
-            for (int i=0; i<contours.size(); i++) {
-                double a = contourArea(contours[i]);
-                if (a > maxArea) { maxArea = a; idx = i; }
-            }
-            if (idx != -1 && maxArea > 400) {
-                locked = true;
-                targetBox = boundingRect(contours[idx]);
-                center = Point(targetBox.x + targetBox.width/2, targetBox.y + targetBox.height/2);
-            }
+        allocCheck.begin();
+        ADS_TIME_STAGE(FRAME);
+        ADS_LAPS(frameLaps);
+        ADS_COUNT(FRAMES, 1);
+        Mat& display = d->display;
+
+        const Track* target = d->engaged >= 0 ? &d->tracks[d->engaged] : nullptr;
+        bool locked = target != nullptr;
+        Rect targetBox = locked ? target->box : Rect();
+        Point center = locked ? target->center() : Point();
+        if (announceEngage && locked) {
+            logData.push("ENGAGE T%d", target->id);
+            announceEngage = false;
         }
 
-        int leftX = 20;
-        putText(display, "UNIT: 777-AGR", Point(leftX, 40), FONT_HERSHEY_SIMPLEX, 0.6, cyan, 1);
-        putText(display, "SEC: CAIRO_N", Point(leftX, 65), FONT_HERSHEY_SIMPLEX, 0.6, cyan, 1);
-        putText(display, "LAT: 30.0444 N", Point(leftX, 90), FONT_HERSHEY_SIMPLEX, 0.5, white, 1);
-        putText(display, "LON: 31.2357 E", Point(leftX, 110), FONT_HERSHEY_SIMPLEX, 0.5, white, 1);
-
-        rectangle(display, Point(leftX, 130), Point(leftX+150, 400), cyan, 1);
-        putText(display, "SYSTEM LOG", Point(leftX+5, 145), FONT_HERSHEY_PLAIN, 1, cyan, 1);
-
-        if (counter % 50 == 0) {
-            stringstream ss; ss << "PING: " << rand()%90 + 10 << "ms";
-            logData.push_back(ss.str());
-            if (logData.size() > 10) logData.erase(logData.begin());
-        }
         for(int i=0; i<logData.size(); i++) {
-            putText(display, logData[i], Point(leftX+5, 170 + i*20), FONT_HERSHEY_PLAIN, 0.9, white, 1);
+            hud.text(logData[i], Point(layout.leftX+5, 170 + i*20), FONT_HERSHEY_PLAIN, 0.9, white, 1);
         }
+        // Live stage timings (telemetry.hpp) under the event log
+        telemetry.draw(hud, layout, cyan);
 
-        int rightX = display.cols - 180;
-        putText(display, "WIND: 12 KTS", Point(rightX, 40), FONT_HERSHEY_PLAIN, 1, cyan, 1);
-        putText(display, "VIS: 10 KM", Point(rightX, 60), FONT_HERSHEY_PLAIN, 1, cyan, 1);
-        putText(display, "TEMP: 34 C", Point(rightX, 80), FONT_HERSHEY_PLAIN, 1, cyan, 1);
+        PipelineStats stats = pipeline.stats();
+        snprintf(text, sizeof(text), "DROP CAP:%lld DET:%lld", (long long)stats.captureDropped, (long long)stats.detectDropped);
+        hud.text(text, Point(layout.rightX - 40, display.rows - 20), FONT_HERSHEY_PLAIN, 1, white, 1);
 
-        line(display, Point(rightX-20, 100), Point(rightX-20, 400), cyan, 2);
-        for(int i=0; i<10; i++) {
-            line(display, Point(rightX-20, 120 + i*30), Point(rightX-10, 120 + i*30), cyan, 1);
-            putText(display, to_string(1000 - i*100), Point(rightX, 125 + i*30), FONT_HERSHEY_PLAIN, 0.8, white, 1);
-        }
         int altY = 400 - (center.y * 300 / display.rows);
         if(!locked) altY = 250;
-        line(display, Point(rightX-25, altY), Point(rightX-5, altY), red, 2);
-        putText(display, "ALT", Point(rightX-45, altY+5), FONT_HERSHEY_PLAIN, 1, red, 1);
+        hud.line(Point(layout.rightX-25, altY), Point(layout.rightX-5, altY), red, 2);
+        hud.text("ALT", Point(layout.rightX-45, altY+5), FONT_HERSHEY_PLAIN, 1, red, 1);
 
-        rectangle(display, Point(300, 10), Point(724, 50), Scalar(0, 50, 0), FILLED);
-        line(display, Point(512, 10), Point(512, 60), red, 2);
         for(int i=0; i<10; i++) {
             int x = 310 + (i * 45 + counter) % 400;
-            line(display, Point(x, 10), Point(x, 25), cyan, 1);
-            if(i%2==0) putText(display, to_string(i*30), Point(x-10, 40), FONT_HERSHEY_PLAIN, 1, white, 1);
-        }
-        putText(display, getCurrentTime(), Point(display.cols/2 - 50, 80), FONT_HERSHEY_SIMPLEX, 0.6, cyan, 1);
-
-        int botY = display.rows - 60;
-        for(int i=0; i<4; i++) {
-            rectangle(display, Point(300 + i*110, botY), Point(400 + i*110, botY+40), cyan, 1);
-            putText(display, "M-" + to_string(i+1), Point(310 + i*110, botY+25), FONT_HERSHEY_PLAIN, 1, white, 1);
-            putText(display, "RDY", Point(360 + i*110, botY+25), FONT_HERSHEY_PLAIN, 1, green, 1);
+            hud.line(Point(x, 10), Point(x, 25), cyan, 1);
+            if(i%2==0) {
+                snprintf(text, sizeof(text), "%d", i*30);
+                hud.text(text, Point(x-10, 40), FONT_HERSHEY_PLAIN, 1, white, 1);
+            }
         }
+        getCurrentTime(text, sizeof(text));
+        hud.text(text, Point(display.cols/2 - 50, 80), FONT_HERSHEY_SIMPLEX, 0.6, cyan, 1);
 
-        int radX = 100, radY = display.rows - 100;
-        circle(display, Point(radX, radY), 70, Scalar(0,100,0), 1);
         radarSweep = (radarSweep + 5) % 360;
         float ang = radarSweep * CV_PI / 180;
-        line(display, Point(radX, radY), Point(radX + 70*cos(ang), radY + 70*sin(ang)), green, 2);
-        putText(display, "RADAR: ON", Point(radX-35, radY+90), FONT_HERSHEY_PLAIN, 1, cyan, 1);
-
-        Point screenCenter(display.cols/2, display.rows/2);
-        line(display, Point(screenCenter.x-20, screenCenter.y), Point(screenCenter.x+20, screenCenter.y), cyan, 1);
-        line(display, Point(screenCenter.x, screenCenter.y-20), Point(screenCenter.x, screenCenter.y+20), cyan, 1);
+        hud.line(Point(layout.radX, layout.radY), Point(layout.radX + 70*cos(ang), layout.radY + 70*sin(ang)), green, 2);
+
+        // Every track other than the engaged one
+        for (const Track& t : d->tracks) {
+            if (!t.visible() || &t == target) continue;
+            hud.bracket(t.box.x-10, t.box.y-10, t.box.width+20, t.box.height+20, white);
+            snprintf(text, sizeof(text), "T%d %s", t.id, classifier.name(t.cls).c_str());
+            hud.text(text, Point(t.box.x, t.box.y-20), FONT_HERSHEY_PLAIN, 1, white, 1);
+            snprintf(text, sizeof(text), "RNG: %d M", 50000 / max(t.box.width, 1));
+            hud.text(text, Point(t.box.x + t.box.width + 10, t.box.y + 20), FONT_HERSHEY_PLAIN, 1, white, 1);
+        }
 
         if (locked) {
-            drawBracket(display, targetBox.x-10, targetBox.y-10, targetBox.width+20, targetBox.height+20, red);
-            line(display, screenCenter, center, red, 1);
+            hud.bracket(targetBox.x-10, targetBox.y-10, targetBox.width+20, targetBox.height+20, red);
+            hud.line(layout.center, center, red, 1);
 
-            circle(display, center, 5, red, FILLED);
-            putText(display, "LOCK", Point(targetBox.x, targetBox.y-20), FONT_HERSHEY_SIMPLEX, 0.8, red, 2);
+            hud.circle(center, 5, red, FILLED);
+            snprintf(text, sizeof(text), "LOCK T%d %s", target->id, classifier.name(target->cls).c_str());
+            hud.text(text, Point(targetBox.x, targetBox.y-20), FONT_HERSHEY_SIMPLEX, 0.8, red, 2);
 
-            string dist = "RNG: " + to_string(50000 / targetBox.width) + " M";
-            putText(display, dist, Point(targetBox.x + targetBox.width + 10, targetBox.y + 20), FONT_HERSHEY_PLAIN, 1, red, 1);
+            snprintf(text, sizeof(text), "RNG: %d M", 50000 / max(targetBox.width, 1));
+            hud.text(text, Point(targetBox.x + targetBox.width + 10, targetBox.y + 20), FONT_HERSHEY_PLAIN, 1, red, 1);
 
-            if(counter % 10 < 5) rectangle(display, Point(0,0), Point(display.cols, display.rows), red, 2);
+            if(counter % 10 < 5) hud.rectangle(Point(0,0), Point(display.cols, display.rows), red, 2);
         } else {
-            drawBracket(display, screenCenter.x-100, screenCenter.y-100, 200, 200, white);
-            if(counter % 40 < 20) putText(display, "NO TARGET", Point(screenCenter.x-60, screenCenter.y+130), FONT_HERSHEY_SIMPLEX, 0.7, red, 1);
+            hud.bracket(layout.center.x-100, layout.center.y-100, 200, 200, white);
+            if(counter % 40 < 20) hud.text("NO TARGET", Point(layout.center.x-60, layout.center.y+130), FONT_HERSHEY_SIMPLEX, 0.7, red, 1);
         }
 
+        if (journal.isOpen()) {
+            record.fill(d->tracks, locked ? target->id : -1);
+            journal.append(record);
+        }
+
+        hud.compose(display);
+        ADS_LAP(frameLaps, HUD);
+        allocCheck.end();
         imshow("EGY_ADS_V2", display);
+        ADS_LAP(frameLaps, IMSHOW);
         counter++;
-        if (waitKey(30) == 27) break;
+
+        int key = pollKey();
+        if (key == 27) break;
+        if (key == 9) {
+            frontEnd.cycleEngaged();
+            announceEngage = true;
+        }
     }
+    pipeline.stop();
+    journal.close();
+    frontEnd.printSummary(pipeline.stats());
     cap.release();
     destroyAllWindows();
     return 0;
@@ -0,0 +1,69 @@
+#pragma once
+
+// Heap allocation counter for the steady-state frame loop. Debug builds
+// replace the global operator new/delete with versions that count
+// allocations per thread; FrameAllocCheck then asserts that a frame made no
+// allocation once the warm-up frames are over. Release builds (NDEBUG) and
+// builds with ADS_NO_ALLOC_COUNTER compile all of this away.
+//
+// The replacement operators are not inline (the standard forbids it), so
+// include this header from exactly one translation unit per program.
+
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#if !defined(NDEBUG) && !defined(ADS_NO_ALLOC_COUNTER)
+#define ADS_ALLOC_COUNTER 1
+#endif
+
+#ifdef ADS_ALLOC_COUNTER
+
+inline thread_local int64_t threadAllocations = 0;
+
+void* operator new(std::size_t n) {
+    threadAllocations++;
+    if (void* p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](std::size_t n) { return ::operator new(n); }
+void* operator new(std::size_t n, const std::nothrow_t&) noexcept {
+    threadAllocations++;
+    return std::malloc(n ? n : 1);
+}
+void* operator new[](std::size_t n, const std::nothrow_t& t) noexcept { return ::operator new(n, t); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+#endif // ADS_ALLOC_COUNTER
+
+// Brackets one frame of a loop: begin() at the top, end() at the bottom.
+// Only allocations made on the calling thread are seen, so OpenCV worker
+// threads and the other pipeline stages do not count.
+class FrameAllocCheck {
+public:
+    explicit FrameAllocCheck(int warmupFrames = 30) : warmup_(warmupFrames) {}
+
+    void begin() {
+#ifdef ADS_ALLOC_COUNTER
+        start_ = threadAllocations;
+#endif
+    }
+
+    void end() {
+#ifdef ADS_ALLOC_COUNTER
+        int64_t n = threadAllocations - start_;
+        if (frames_++ < warmup_) return;
+        if (n) std::fprintf(stderr, "frame %lld: %lld heap allocations after warm-up\n", (long long)frames_, (long long)n);
+        assert(n == 0 && "heap allocation in the steady-state frame loop");
+#endif
+    }
+
+private:
+    int warmup_;
+    int64_t frames_ = 0, start_ = 0;
+};
@@ -0,0 +1,389 @@
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "replay.hpp"
+#include "condition.hpp"
+#include "threshold.hpp"
+#include "classify.hpp"
+#include "bitmask.hpp"
+#include "blobs.hpp"
+#include "detect.hpp"
+#include "tiled.hpp"
+#include "hud.hpp"
+#include "yuv.hpp"
+
+using namespace cv;
+using namespace std;
+
+#ifndef ADS_VERSION
+#define ADS_VERSION "unknown"
+#endif
+
+// Micro-benchmarks of the detection and HUD kernels, each next to the
+// OpenCV sequence it replaced, at 480p / 720p / 1080p / 4K on synthetic
+// frames and optionally on frames from a recording.
+//
+// bench [--sizes 480p,720p,1080p,4k]
+//       [--kernels condition,threshold,yuv,classify,morphology,blobs,tiled,hud]
+//       [--source <clip>] [--source-frames <n>] [--min-time <s>] [--threads 1,2,4,8]
+//       [--json <file>] [--csv <file>]
+// With a list of thread counts every case runs once per count, which shows
+// how each kernel scales. The JSON / CSV output carries the build version so
+// runs of different versions can be compared.
+
+struct BenchCase {
+    string kernel, variant, input, size;
+    Size dims;
+    int threads = 0;
+    int iterations = 0;
+    double meanMs = 0, p50Ms = 0, p99Ms = 0, minMs = 0;
+
+    double mpixPerSec() const { return meanMs > 0 ? dims.area() / (meanMs * 1000) : 0; }
+};
+
+// Frame with a noisy, unsaturated background and a few blue targets of a
+// size that scales with the resolution, so every kernel has work to do.
+static Mat syntheticFrame(Size size, int index) {
+    RNG rng(0x5eed + index);
+    Mat small(size.height / 8, size.width / 8, CV_8UC3), frame;
+    rng.fill(small, RNG::UNIFORM, Scalar(60, 70, 70), Scalar(110, 120, 120));
+    resize(small, frame, size, 0, 0, INTER_LINEAR);
+    Mat noise(size, CV_8UC3);
+    rng.fill(noise, RNG::NORMAL, Scalar::all(8), Scalar::all(6));
+    frame += noise;
+    int unit = max(size.width / 64, 4);
+    for (int k = 0; k < 12; k++) {
+        Point c(rng.uniform(0, size.width), rng.uniform(0, size.height));
+        Size axes(rng.uniform(unit / 2, unit * 2), rng.uniform(unit / 2, unit * 2));
+        ellipse(frame, c, axes, rng.uniform(0, 180), 0, 360, Scalar(200, 60, 20), FILLED);
+    }
+    return frame;
+}
+
+// Runs 'run(i)' with i = 0, 1, ... until minTime has passed (at least 10
+// runs, after 3 untimed warm-up runs) and keeps one sample per run.
+static BenchCase timeKernel(const string& kernel, const string& variant, const string& input, const string& sizeName,
+                            Size dims, double minTime, const function<void(int)>& run) {
+    for (int i = 0; i < 3; i++) run(i);
+    vector<double> samples;
+    double toMs = 1000.0 / getTickFrequency(), total = 0;
+    for (int i = 0; samples.size() < 10 || total < minTime * 1000; i++) {
+        int64 t0 = getTickCount();
+        run(i);
+        double ms = (getTickCount() - t0) * toMs;
+        samples.push_back(ms);
+        total += ms;
+    }
+    BenchCase c;
+    c.kernel = kernel;
+    c.variant = variant;
+    c.input = input;
+    c.size = sizeName;
+    c.dims = dims;
+    c.iterations = (int)samples.size();
+    c.meanMs = total / samples.size();
+    c.p50Ms = BenchReport::percentile(samples, 0.50);
+    c.p99Ms = BenchReport::percentile(samples, 0.99);
+    c.minMs = *min_element(samples.begin(), samples.end());
+    return c;
+}
+
+// Per-frame HUD content like the live loop: log lines, track brackets and
+// labels, the radar sweep.
+static void drawDynamicHud(HudCompositor& hud, const HudLayout& l, int i) {
+    Scalar white(200, 200, 200), red(0, 0, 255), green(0, 255, 0), cyan(255, 255, 0);
+    char text[32];
+    for (int k = 0; k < 10; k++) {
+        snprintf(text, sizeof(text), "PING: %dms", (i + k) % 90 + 10);
+        hud.text(text, Point(l.leftX + 5, 170 + k * 20), FONT_HERSHEY_PLAIN, 0.9, white, 1);
+    }
+    for (int k = 0; k < 4; k++) {
+        Rect box(200 + k * 150 + i % 40, 150 + k * 60, 60, 40);
+        hud.bracket(box.x - 10, box.y - 10, box.width + 20, box.height + 20, k ? white : red);
+        snprintf(text, sizeof(text), "T%d", k + 1);
+        hud.text(text, Point(box.x, box.y - 20), FONT_HERSHEY_PLAIN, 1, k ? white : red, 1);
+    }
+    float ang = (i * 5 % 360) * (float)CV_PI / 180;
+    hud.line(Point(l.radX, l.radY), Point(l.radX + (int)(70 * cos(ang)), l.radY + (int)(70 * sin(ang))), green, 2);
+    getCurrentTime(text, sizeof(text));
+    hud.text(text, Point(l.size.width / 2 - 50, 80), FONT_HERSHEY_SIMPLEX, 0.6, cyan, 1);
+}
+
+// The original immediate-mode HUD: every widget drawn with putText / line
+// onto each frame.
+static void drawHudLegacy(Mat& display, const HudLayout& l, int i) {
+    drawStaticHud(display, l, Scalar(255, 255, 0), Scalar(200, 200, 200), Scalar(0, 0, 255));
+    Scalar white(200, 200, 200), red(0, 0, 255), green(0, 255, 0);
+    for (int k = 0; k < 10; k++)
+        putText(display, "PING: " + to_string((i + k) % 90 + 10) + "ms", Point(l.leftX + 5, 170 + k * 20),
+                FONT_HERSHEY_PLAIN, 0.9, white, 1);
+    for (int k = 0; k < 4; k++) {
+        Rect box(200 + k * 150 + i % 40, 150 + k * 60, 60, 40);
+        drawBracket(display, box.x - 10, box.y - 10, box.width + 20, box.height + 20, k ? white : red);
+        putText(display, "T" + to_string(k + 1), Point(box.x, box.y - 20), FONT_HERSHEY_PLAIN, 1, k ? white : red, 1);
+    }
+    float ang = (i * 5 % 360) * (float)CV_PI / 180;
+    line(display, Point(l.radX, l.radY), Point(l.radX + (int)(70 * cos(ang)), l.radY + (int)(70 * sin(ang))), green, 2);
+}
+
+static vector<string> split(const string& s) {
+    vector<string> v;
+    stringstream ss(s);
+    string item;
+    while (getline(ss, item, ',')) v.push_back(item);
+    return v;
+}
+
+int main(int argc, char** argv) {
+    vector<string> sizeNames{"480p", "720p", "1080p", "4k"};
+    vector<string> kernels{"condition", "threshold", "yuv", "classify", "morphology", "blobs", "tiled", "hud"};
+    vector<int> threadCounts{getNumThreads()};
+    string source, jsonPath, csvPath;
+    int sourceFrames = 16;
+    double minTime = 0.5;
+
+    for (int i = 1; i < argc; i++) {
+        string a = argv[i];
+        bool more = i + 1 < argc;
+        if (a == "--sizes" && more) sizeNames = split(argv[++i]);
+        else if (a == "--kernels" && more) kernels = split(argv[++i]);
+        else if (a == "--source" && more) source = argv[++i];
+        else if (a == "--source-frames" && more) sourceFrames = stoi(argv[++i]);
+        else if (a == "--min-time" && more) minTime = stod(argv[++i]);
+        else if (a == "--threads" && more) {
+            threadCounts.clear();
+            for (const string& t : split(argv[++i])) threadCounts.push_back(stoi(t));
+        }
+        else if (a == "--json" && more) jsonPath = argv[++i];
+        else if (a == "--csv" && more) csvPath = argv[++i];
+        else {
+            cerr << "Unknown argument " << a << endl;
+            return -1;
+        }
+    }
+    auto wanted = [&](const string& k) { return find(kernels.begin(), kernels.end(), k) != kernels.end(); };
+
+    const vector<pair<string, Size>> known{
+        {"480p", Size(640, 480)}, {"720p", Size(1280, 720)}, {"1080p", Size(1920, 1080)}, {"4k", Size(3840, 2160)}};
+
+    vector<Mat> recorded;
+    if (!source.empty()) {
+        FrameSource in({source});
+        Mat f;
+        while ((int)recorded.size() < sourceFrames && in.read(f)) recorded.push_back(f.clone());
+        if (recorded.empty()) cerr << "Warning: no frames read from " << source << endl;
+    }
+
+    const Scalar lower(100, 150, 0), upper(140, 255, 255);
+    const double minArea = 400;
+
+    // Four colour classes as one table, and the blue band alone
+    const vector<pair<Scalar, Scalar>> bands{{lower, upper}, {Scalar(170, 150, 50), Scalar(10, 255, 255)},
+                                             {Scalar(40, 100, 50), Scalar(80, 255, 255)},
+                                             {Scalar(20, 100, 100), Scalar(35, 255, 255)}};
+    ColorClassifier oneClass, fourClasses;
+    oneClass.addBand("BLUE", lower, upper);
+    for (size_t k = 0; k < bands.size(); k++) fourClasses.addBand("C" + to_string(k), bands[k].first, bands[k].second);
+    if (wanted("classify")) {
+        oneClass.compile();
+        fourClasses.compile();
+    }
+    vector<BenchCase> cases;
+
+    for (const string& sizeName : sizeNames) {
+        auto it = find_if(known.begin(), known.end(), [&](const pair<string, Size>& k) { return k.first == sizeName; });
+        if (it == known.end()) {
+            cerr << "Unknown size " << sizeName << endl;
+            return -1;
+        }
+        Size size = it->second;
+
+        vector<pair<string, vector<Mat>>> inputs;
+        inputs.push_back({"synthetic", {}});
+        for (int k = 0; k < 8; k++) inputs.back().second.push_back(syntheticFrame(size, k));
+        if (!recorded.empty()) {
+            inputs.push_back({"recorded", {}});
+            for (const Mat& f : recorded) {
+                inputs.back().second.emplace_back();
+                resize(f, inputs.back().second.back(), size);
+            }
+        }
+
+        for (const auto& input : inputs) {
+            const vector<Mat>& frames = input.second;
+            int n = (int)frames.size();
+            auto add = [&](const string& kernel, const string& variant, const function<void(int)>& run) {
+                for (int threads : threadCounts) {
+                    setNumThreads(threads);
+                    cases.push_back(timeKernel(kernel, variant, input.first, sizeName, size, minTime, run));
+                    BenchCase& c = cases.back();
+                    c.threads = getNumThreads();
+                    cout << left << setw(11) << c.kernel << setw(10) << c.variant << setw(10) << c.input << setw(6)
+                         << c.size << right << setw(3) << c.threads << "T" << fixed << setprecision(3) << setw(10)
+                         << c.meanMs << setw(10) << c.p50Ms << setw(10) << c.p99Ms << setprecision(1) << setw(9)
+                         << c.mpixPerSec() << " Mpix/s" << endl;
+                }
+            };
+
+            // Inputs of the later stages, computed once
+            vector<BitMask> bits(n), opened(n);
+            vector<Mat> masks(n), openedMats(n);
+            BitMorphology morph;
+            Mat element = getStructuringElement(MORPH_ELLIPSE, Size(5, 5));
+            for (int i = 0; i < n; i++) {
+                bgrToMask(frames[i], lower, upper, bits[i]);
+                morph.openEllipse5(bits[i], opened[i]);
+                toMat(bits[i], masks[i]);
+                toMat(opened[i], openedMats[i]);
+            }
+
+            if (wanted("condition")) {
+                ConditionConfig cc;
+                FrameConditioner condition(cc);
+                Mat frame, display;
+                add("condition", "fused", [&](int i) { condition(frames[i % n], frame, display); });
+                add("condition", "legacy", [&](int i) { conditionLegacy(frames[i % n], cc, frame, display); });
+            }
+            if (wanted("threshold")) {
+                BitMask out;
+                Mat mask, hsv;
+                add("threshold", "bits", [&](int i) { bgrToMask(frames[i % n], lower, upper, out); });
+                add("threshold", "bytes", [&](int i) { bgrToMask(frames[i % n], lower, upper, mask); });
+                add("threshold", "legacy", [&](int i) {
+                    cvtColor(frames[i % n], hsv, COLOR_BGR2HSV);
+                    inRange(hsv, lower, upper, mask);
+                });
+            }
+            if (wanted("yuv")) {
+                // NV12 as the camera delivers it: classified on the chroma
+                // grid, against converting to BGR first as VideoCapture does
+                vector<Mat> nv12(n);
+                for (int i = 0; i < n; i++) bgrToNv12(frames[i], nv12[i]);
+                BitMask out;
+                Mat bgr;
+                Rect all(Point(), Size(size.width / 2, size.height / 2));
+                add("yuv", "chroma", [&](int i) { yuvToMask(nv12[i % n], YuvFormat::NV12, all, lower, upper, out); });
+                add("yuv", "legacy", [&](int i) {
+                    cvtColor(nv12[i % n], bgr, COLOR_YUV2BGR_NV12);
+                    bgrToMask(bgr, lower, upper, out);
+                });
+            }
+            if (wanted("classify")) {
+                // Per-pixel cost of the table does not depend on the class
+                // count; one threshold pass per class does
+                vector<BitMask> out;
+                BitMask mask;
+                add("classify", "lut-1", [&](int i) { oneClass.masks(frames[i % n], out); });
+                add("classify", "lut-4", [&](int i) { fourClasses.masks(frames[i % n], out); });
+                add("classify", "band-4", [&](int i) {
+                    for (const auto& b : bands) {
+                        if (b.first[0] > b.second[0]) {
+                            bgrToMask(frames[i % n], b.first, Scalar(180, b.second[1], b.second[2]), mask);
+                            bgrToMask(frames[i % n], Scalar(0, b.first[1], b.first[2]), b.second, mask);
+                        } else {
+                            bgrToMask(frames[i % n], b.first, b.second, mask);
+                        }
+                    }
+                });
+            }
+            if (wanted("morphology")) {
+                BitMask out;
+                Mat tmp, mask;
+                add("morphology", "bits", [&](int i) { morph.openEllipse5(bits[i % n], out); });
+                add("morphology", "legacy", [&](int i) {
+                    erode(masks[i % n], tmp, element);
+                    dilate(tmp, mask, element);
+                });
+            }
+            if (wanted("blobs")) {
+                BlobExtractor extractor;
+                vector<vector<Point>> contours;
+                Rect box;
+                add("blobs", "bits", [&](int i) { largestBlob(opened[i % n], Point(), minArea, box, extractor); });
+                add("blobs", "bytes", [&](int i) { largestBlob(openedMats[i % n], Point(), minArea, box, extractor); });
+                add("blobs", "legacy", [&](int i) { largestContour(openedMats[i % n], Point(), minArea, box, contours); });
+            }
+            if (wanted("tiled")) {
+                // Threshold, opening and blobs over the whole frame: fused
+                // per row band, against one full-frame pass per stage
+                TiledDetector tiled;
+                BitMask mask, out;
+                BlobExtractor extractor;
+                vector<Rect> boxes;
+                vector<int> classes;
+                add("tiled", "bands", [&](int i) {
+                    boxes.clear();
+                    classes.clear();
+                    tiled.mask(frames[i % n], lower, upper, true);
+                    tiled.extract(Point(), minArea, boxes, classes);
+                });
+                add("tiled", "staged", [&](int i) {
+                    boxes.clear();
+                    bgrToMask(frames[i % n], lower, upper, mask);
+                    morph.openEllipse5(mask, out);
+                    allBlobs(out, Point(), minArea, boxes, extractor);
+                });
+            }
+            if (wanted("hud")) {
+                HudLayout layout(size);
+                HudCompositor hud(size);
+                hud.buildStatic([&](Mat& layer) { drawStaticHud(layer, layout, Scalar(255, 255, 0), Scalar(200, 200, 200), Scalar(0, 0, 255)); });
+                hud.preloadFont(FONT_HERSHEY_PLAIN, 0.9);
+                hud.preloadFont(FONT_HERSHEY_PLAIN, 1);
+                hud.preloadFont(FONT_HERSHEY_SIMPLEX, 0.6);
+                Mat display = frames[0].clone();
+                add("hud", "retained", [&](int i) {
+                    drawDynamicHud(hud, layout, i);
+                    hud.compose(display);
+                });
+                add("hud", "legacy", [&](int i) { drawHudLegacy(display, layout, i); });
+            }
+        }
+    }
+
+    time_t now = time(0);
+    char date[32];
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+
+    if (!jsonPath.empty()) {
+        ofstream json(jsonPath);
+        if (!json) {
+            cerr << "Warning: could not write " << jsonPath << endl;
+        } else {
+            json << fixed << setprecision(4);
+            json << "{\n  \"version\": \"" << ADS_VERSION << "\",\n  \"opencv\": \"" << CV_VERSION
+                 << "\",\n  \"cpus\": " << getNumberOfCPUs() << ",\n  \"date\": \"" << date << "\",\n  \"cases\": [\n";
+            for (size_t k = 0; k < cases.size(); k++) {
+                const BenchCase& c = cases[k];
+                json << "    {\"kernel\": \"" << c.kernel << "\", \"variant\": \"" << c.variant << "\", \"input\": \""
+                     << c.input << "\", \"size\": \"" << c.size << "\", \"width\": " << c.dims.width
+                     << ", \"height\": " << c.dims.height << ", \"threads\": " << c.threads << ", \"iterations\": " << c.iterations
+                     << ", \"mean_ms\": " << c.meanMs << ", \"p50_ms\": " << c.p50Ms << ", \"p99_ms\": " << c.p99Ms
+                     << ", \"min_ms\": " << c.minMs << ", \"mpix_per_s\": " << c.mpixPerSec() << "}"
+                     << (k + 1 < cases.size() ? ",\n" : "\n");
+            }
+            json << "  ]\n}\n";
+        }
+    }
+    if (!csvPath.empty()) {
+        ofstream csv(csvPath);
+        if (!csv) {
+            cerr << "Warning: could not write " << csvPath << endl;
+        } else {
+            csv << fixed << setprecision(4);
+            csv << "version,kernel,variant,input,size,width,height,threads,iterations,mean_ms,p50_ms,p99_ms,min_ms,mpix_per_s\n";
+            for (const BenchCase& c : cases)
+                csv << ADS_VERSION << "," << c.kernel << "," << c.variant << "," << c.input << "," << c.size << ","
+                    << c.dims.width << "," << c.dims.height << "," << c.threads << "," << c.iterations << "," << c.meanMs << ","
+                    << c.p50Ms << "," << c.p99Ms << "," << c.minMs << "," << c.mpixPerSec() << "\n";
+        }
+    }
+    return 0;
+}
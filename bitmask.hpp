@@ -0,0 +1,194 @@
+#pragma once
+
+// Binary mask packed 64 pixels per word, and morphology on it. Bit x & 63 of
+// word x >> 6 is pixel x; the unused bits at the end of each row stay zero.
+// Erosion and dilation work on whole words, so one AND/OR handles 64 pixels,
+// and the 5x5 ellipse is split into shapes that need only shifts:
+//
+//     . . # . .       # # # # #       . . # . .
+//     # # # # #       # # # # #       . . # . .
+//     # # # # #   =   # # # # #   U   . . # . .
+//     # # # # #                       . . # . .
+//     . . # . .                       . . # . .
+//
+// erode(A, B1 U B2) = erode(A, B1) & erode(A, B2) and the same with | for
+// dilate; the 5x3 rectangle is separable into a 5-wide row and a 3-high
+// column. Borders behave like OpenCV's defaults: pixels outside the image
+// count as set for erosion and as clear for dilation.
+
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+class BitMask {
+public:
+    BitMask() {}
+    BitMask(int rows, int cols) { create(rows, cols); }
+
+    // Contents are undefined afterwards, except for the zeroed row padding.
+    void create(int rows, int cols) {
+        rows_ = rows;
+        cols_ = cols;
+        stride_ = (cols + 63) / 64;
+        words_.resize((size_t)rows * stride_);
+        if (cols & 63)
+            for (int y = 0; y < rows; y++) row(y)[stride_ - 1] = 0;
+    }
+
+    void clear() { std::fill(words_.begin(), words_.end(), 0); }
+
+    int rows() const { return rows_; }
+    int cols() const { return cols_; }
+    int stride() const { return stride_; }   // words per row
+    bool empty() const { return rows_ == 0 || cols_ == 0; }
+    size_t bytes() const { return words_.size() * sizeof(uint64_t); }
+
+    uint64_t* row(int y) { return words_.data() + (size_t)y * stride_; }
+    const uint64_t* row(int y) const { return words_.data() + (size_t)y * stride_; }
+    bool at(int y, int x) const { return (row(y)[x >> 6] >> (x & 63)) & 1; }
+
+    // Valid bits of the last word of a row.
+    uint64_t lastWordMask() const { return (cols_ & 63) ? (~0ull >> (64 - (cols_ & 63))) : ~0ull; }
+
+private:
+    int rows_ = 0, cols_ = 0, stride_ = 0;
+    std::vector<uint64_t> words_;
+};
+
+// n bytes (non-zero = set) into (n + 63) / 64 words.
+inline void packBits(const uchar* src, int n, uint64_t* dst) {
+    int x = 0;
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    for (; x + 64 <= n; x += 64) {
+        uint64_t w = 0;
+        for (int k = 0; k < 4; k++) {
+            __m128i v = _mm_loadu_si128((const __m128i*)(src + x + 16 * k));
+            w |= (uint64_t)(~_mm_movemask_epi8(_mm_cmpeq_epi8(v, zero)) & 0xFFFF) << (16 * k);
+        }
+        dst[x >> 6] = w;
+    }
+#endif
+    for (; x < n; x += 64) {
+        uint64_t w = 0;
+        for (int k = 0; k < 64 && x + k < n; k++) w |= (uint64_t)(src[x + k] != 0) << k;
+        dst[x >> 6] = w;
+    }
+}
+
+inline void toBits(const cv::Mat& mask, BitMask& bits) {
+    CV_Assert(mask.type() == CV_8UC1);
+    bits.create(mask.rows, mask.cols);
+    cv::parallel_for_(cv::Range(0, mask.rows), [&](const cv::Range& rows) {
+        for (int y = rows.start; y < rows.end; y++) packBits(mask.ptr<uchar>(y), mask.cols, bits.row(y));
+    }, mask.total() / (double)(1 << 18));
+}
+
+// Set pixels become 255, clear ones 0.
+inline void toMat(const BitMask& bits, cv::Mat& mask) {
+    mask.create(bits.rows(), bits.cols(), CV_8UC1);
+    cv::parallel_for_(cv::Range(0, bits.rows()), [&](const cv::Range& rows) {
+        for (int y = rows.start; y < rows.end; y++) {
+            const uint64_t* src = bits.row(y);
+            uchar* dst = mask.ptr<uchar>(y);
+            for (int x = 0; x < bits.cols(); x++) dst[x] = (uchar)(0 - ((src[x >> 6] >> (x & 63)) & 1));
+        }
+    }, mask.total() / (double)(1 << 18));
+}
+
+class BitMorphology {
+public:
+    void erodeEllipse5(const BitMask& src, BitMask& dst) { ellipse5<true>(src, dst); }
+    void dilateEllipse5(const BitMask& src, BitMask& dst) { ellipse5<false>(src, dst); }
+
+    void openEllipse5(const BitMask& src, BitMask& dst) {
+        ellipse5<true>(src, tmp_);
+        ellipse5<false>(tmp_, dst);
+    }
+
+    void closeEllipse5(const BitMask& src, BitMask& dst) {
+        ellipse5<false>(src, tmp_);
+        ellipse5<true>(tmp_, dst);
+    }
+
+    // Rectangle of (2 * rx + 1) x (2 * ry + 1), rx < 64.
+    void erodeRect(const BitMask& src, BitMask& dst, int rx, int ry) { rect<true>(src, dst, rx, ry); }
+    void dilateRect(const BitMask& src, BitMask& dst, int rx, int ry) { rect<false>(src, dst, rx, ry); }
+
+private:
+    // 'out' = AND (erode) or OR (dilate) of the row shifted by -r..r pixels.
+    template <bool Erode>
+    static void horizontal(const uint64_t* in, uint64_t* out, int n, int r, uint64_t lastMask) {
+        const uint64_t outside = Erode ? ~0ull : 0;
+        auto word = [&](int i) {
+            if (i < 0 || i >= n) return outside;
+            return i == n - 1 && Erode ? in[i] | ~lastMask : in[i];
+        };
+        for (int i = 0; i < n; i++) {
+            uint64_t prev = word(i - 1), cur = word(i), next = word(i + 1), acc = cur;
+            for (int k = 1; k <= r; k++) {
+                uint64_t right = (cur >> k) | (next << (64 - k));   // pixel x + k
+                uint64_t left = (cur << k) | (prev >> (64 - k));    // pixel x - k
+                acc = Erode ? acc & left & right : acc | left | right;
+            }
+            out[i] = i == n - 1 ? acc & lastMask : acc;
+        }
+    }
+
+    // AND / OR of rows y - r .. y + r of 'src' into 'out', combined with
+    // what 'out' holds already when 'accumulate' is set.
+    template <bool Erode>
+    static void vertical(const BitMask& src, int y, int r, uint64_t* out, bool accumulate) {
+        int n = src.stride();
+        if (!accumulate) std::fill(out, out + n, Erode ? ~0ull : 0);
+        for (int k = -r; k <= r; k++) {
+            int yy = y + k;
+            if (yy < 0 || yy >= src.rows()) continue;   // set for AND, clear for OR: no effect either way
+            const uint64_t* in = src.row(yy);
+            if (Erode) for (int i = 0; i < n; i++) out[i] &= in[i];
+            else for (int i = 0; i < n; i++) out[i] |= in[i];
+        }
+    }
+
+    template <bool Erode>
+    void rect(const BitMask& src, BitMask& dst, int rx, int ry) {
+        CV_Assert(&src != &dst && rx < 64);
+        h_.create(src.rows(), src.cols());
+        dst.create(src.rows(), src.cols());
+        uint64_t lastMask = src.lastWordMask();
+        cv::parallel_for_(cv::Range(0, src.rows()), [&](const cv::Range& rows) {
+            for (int y = rows.start; y < rows.end; y++)
+                horizontal<Erode>(src.row(y), h_.row(y), src.stride(), rx, lastMask);
+        }, stripes(src));
+        cv::parallel_for_(cv::Range(0, src.rows()), [&](const cv::Range& rows) {
+            for (int y = rows.start; y < rows.end; y++) vertical<Erode>(h_, y, ry, dst.row(y), false);
+        }, stripes(src));
+    }
+
+    template <bool Erode>
+    void ellipse5(const BitMask& src, BitMask& dst) {
+        CV_Assert(&src != &dst);
+        h_.create(src.rows(), src.cols());
+        dst.create(src.rows(), src.cols());
+        uint64_t lastMask = src.lastWordMask();
+        cv::parallel_for_(cv::Range(0, src.rows()), [&](const cv::Range& rows) {
+            for (int y = rows.start; y < rows.end; y++)
+                horizontal<Erode>(src.row(y), h_.row(y), src.stride(), 2, lastMask);
+        }, stripes(src));
+        cv::parallel_for_(cv::Range(0, src.rows()), [&](const cv::Range& rows) {
+            for (int y = rows.start; y < rows.end; y++) {
+                vertical<Erode>(h_, y, 1, dst.row(y), false);   // 5x3 rectangle
+                vertical<Erode>(src, y, 2, dst.row(y), true);   // 1x5 column
+            }
+        }, stripes(src));
+    }
+
+    static double stripes(const BitMask& m) { return m.rows() * (double)m.stride() / 256; }
+
+    BitMask h_, tmp_;
+};
@@ -0,0 +1,281 @@
+#pragma once
+
+// Contour-free blob extraction. One pass over a binary mask splits every row
+// into runs of foreground pixels; runs that touch (8-connectivity) are joined
+// with union-find, and each resulting blob gets its pixel count, bounding box,
+// centroid and the area findContours + contourArea would give for its outer
+// contour. Row bands are labelled in parallel and stitched along their seams.
+
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <vector>
+#include "bitmask.hpp"
+
+struct Blob {
+    double area = 0;        // contourArea of the outer contour
+    int pixels = 0;
+    cv::Rect box;
+    cv::Point2f centroid;
+};
+
+class BlobExtractor {
+public:
+    // Appends every blob whose area is above minArea, in frame coordinates
+    // ('offset' is the position of the mask inside the frame).
+    //
+    // contourArea runs the shoelace formula over the boundary pixel centres,
+    // so by Pick's theorem it equals pixels - boundary / 2 - 1, where a
+    // boundary pixel has a background 4-neighbour. That only holds when the
+    // outer contour is a simple polygon through every boundary pixel once:
+    // blobs with a hole (a cycle between runs) or a pinch (a boundary pixel
+    // whose 8-neighbourhood has more than one foreground arc) are traced
+    // exactly with findContours on just that blob instead. Blobs with no more
+    // than minArea pixels are rejected before either, since area < pixels.
+    void extract(const cv::Mat& mask, cv::Point offset, double minArea, std::vector<Blob>& blobs) {
+        CV_Assert(mask.type() == CV_8UC1);
+        label<ByteRows>(mask, mask.rows, mask.cols);
+        collect(offset, minArea, blobs);
+    }
+
+    // The same for a packed mask; runs are found a word at a time.
+    void extract(const BitMask& mask, cv::Point offset, double minArea, std::vector<Blob>& blobs) {
+        label<BitRows>(mask, mask.rows(), mask.cols());
+        collect(offset, minArea, blobs);
+    }
+
+    // Either of the above, into a buffer owned by the extractor (valid until
+    // the next call).
+    template <typename Mask>
+    const std::vector<Blob>& extract(const Mask& mask, cv::Point offset, double minArea) {
+        blobs_.clear();
+        extract(mask, offset, minArea, blobs_);
+        return blobs_;
+    }
+
+private:
+    // Row access for the two mask types.
+    struct ByteRows {
+        typedef uchar Word;
+        static const uchar* row(const cv::Mat& m, int y) { return m.ptr<uchar>(y); }
+        static bool at(const uchar* r, int x) { return r[x] != 0; }
+        static int nextSet(const uchar* r, int x, int cols) {
+            while (x < cols && !r[x]) x++;
+            return x;
+        }
+        static int nextClear(const uchar* r, int x, int cols) {
+            while (x < cols && r[x]) x++;
+            return x;
+        }
+    };
+
+    struct BitRows {
+        typedef uint64_t Word;
+        static const uint64_t* row(const BitMask& m, int y) { return m.row(y); }
+        static bool at(const uint64_t* r, int x) { return (r[x >> 6] >> (x & 63)) & 1; }
+        static int nextSet(const uint64_t* r, int x, int cols) { return scan(r, x, cols, 0); }
+        static int nextClear(const uint64_t* r, int x, int cols) { return scan(r, x, cols, ~0ull); }
+        // First bit at or after x that differs from 'skip' (0: set bits, ~0: clear bits).
+        static int scan(const uint64_t* r, int x, int cols, uint64_t skip) {
+            if (x >= cols) return cols;
+            int i = x >> 6, n = (cols + 63) >> 6;
+            uint64_t w = (r[i] ^ skip) & (~0ull << (x & 63));
+            while (!w) {
+                if (++i == n) return cols;
+                w = r[i] ^ skip;
+            }
+            return std::min(cols, i * 64 + __builtin_ctzll(w));
+        }
+    };
+
+    template <typename Rows, typename Mask>
+    void label(const Mask& mask, int rows, int cols) {
+        int bandCount = std::max(1, std::min(cv::getNumThreads(), rows / 32));
+        bands_.resize(bandCount);
+        cv::parallel_for_(cv::Range(0, bandCount), [&](const cv::Range& r) {
+            for (int b = r.start; b < r.end; b++)
+                labelBand<Rows>(mask, rows, cols, rows * b / bandCount, rows * (b + 1) / bandCount, bands_[b]);
+        });
+
+        // Concatenate the bands, then join runs across each seam.
+        runs_.clear();
+        parent_.clear();
+        for (Band& band : bands_) {
+            int base = (int)runs_.size();
+            band.base = base;
+            runs_.insert(runs_.end(), band.runs.begin(), band.runs.end());
+            for (int p : band.parent) parent_.push_back(p + base);
+        }
+        for (int b = 1; b < bandCount; b++) {
+            const Band& above = bands_[b - 1];
+            const Band& below = bands_[b];
+            connectRows(above.base + above.lastRowStart, above.base + (int)above.runs.size(),
+                        below.base, below.base + below.firstRowEnd);
+        }
+
+        // Gather per-blob statistics at the roots.
+        label_.assign(runs_.size(), -1);
+        stats_.clear();
+        for (size_t i = 0; i < runs_.size(); i++) {
+            int root = find((int)i);
+            if (label_[root] < 0) {
+                label_[root] = (int)stats_.size();
+                stats_.push_back(Stats());
+            }
+            Stats& s = stats_[label_[root]];
+            const Run& run = runs_[i];
+            int n = run.x1 - run.x0;
+            s.pixels += n;
+            s.boundary += run.boundary;
+            s.sumX += (double)n * (run.x0 + run.x1 - 1) / 2;
+            s.sumY += (double)n * run.y;
+            s.x0 = std::min(s.x0, run.x0);
+            s.x1 = std::max(s.x1, run.x1);
+            s.y0 = std::min(s.y0, run.y);
+            s.y1 = std::max(s.y1, run.y + 1);
+            s.irregular |= run.irregular;
+        }
+    }
+
+    void collect(cv::Point offset, double minArea, std::vector<Blob>& blobs) {
+        for (int k = 0; k < (int)stats_.size(); k++) {
+            const Stats& s = stats_[k];
+            if (s.pixels <= minArea) continue;
+            Blob blob;
+            blob.pixels = s.pixels;
+            blob.area = s.irregular ? traceArea(k, s) : std::max(0.0, s.pixels - s.boundary / 2.0 - 1);
+            if (blob.area <= minArea) continue;
+            blob.box = cv::Rect(s.x0 + offset.x, s.y0 + offset.y, s.x1 - s.x0, s.y1 - s.y0);
+            blob.centroid = cv::Point2f((float)(s.sumX / s.pixels + offset.x), (float)(s.sumY / s.pixels + offset.y));
+            blobs.push_back(blob);
+        }
+    }
+
+    struct Run {
+        int y, x0, x1;      // [x0, x1)
+        int boundary;       // pixels of the run with a background 4-neighbour
+        bool irregular;     // closes a cycle or has a pinch pixel
+    };
+
+    struct Band {
+        std::vector<Run> runs;
+        std::vector<int> parent;    // band-local union-find
+        int firstRowEnd = 0;        // runs [0, firstRowEnd) are on the first row
+        int lastRowStart = 0;       // runs [lastRowStart, size) are on the last row
+        int base = 0;               // index of runs[0] after concatenation
+    };
+
+    struct Stats {
+        int pixels = 0, boundary = 0;
+        double sumX = 0, sumY = 0;
+        int x0 = INT_MAX, y0 = INT_MAX, x1 = INT_MIN, y1 = INT_MIN;
+        bool irregular = false;
+    };
+
+    static int findIn(std::vector<int>& parent, int i) {
+        while (parent[i] != i) {
+            parent[i] = parent[parent[i]];
+            i = parent[i];
+        }
+        return i;
+    }
+
+    // False when a and b were already connected, i.e. the new link closes a cycle.
+    static bool unite(std::vector<int>& parent, int a, int b) {
+        a = findIn(parent, a);
+        b = findIn(parent, b);
+        if (a == b) return false;
+        parent[std::max(a, b)] = std::min(a, b);
+        return true;
+    }
+
+    int find(int i) { return findIn(parent_, i); }
+
+    // Unions runs of two consecutive rows that touch, including diagonally.
+    static void connect(std::vector<Run>& runs, std::vector<int>& parent, int a0, int a1, int b0, int b1) {
+        int i = a0;
+        for (int j = b0; j < b1; j++) {
+            while (i < a1 && runs[i].x1 < runs[j].x0) i++;
+            for (int k = i; k < a1 && runs[k].x0 <= runs[j].x1; k++)
+                if (!unite(parent, k, j)) runs[j].irregular = true;
+        }
+    }
+
+    void connectRows(int a0, int a1, int b0, int b1) { connect(runs_, parent_, a0, a1, b0, b1); }
+
+    template <typename Rows, typename Mask>
+    static void labelBand(const Mask& mask, int rows, int cols, int y0, int y1, Band& band) {
+        typedef typename Rows::Word Word;
+        band.runs.clear();
+        band.parent.clear();
+        band.firstRowEnd = band.lastRowStart = 0;
+        int prevStart = 0, prevEnd = 0;
+        for (int y = y0; y < y1; y++) {
+            const Word* row = Rows::row(mask, y);
+            const Word* up = y > 0 ? Rows::row(mask, y - 1) : nullptr;
+            const Word* down = y + 1 < rows ? Rows::row(mask, y + 1) : nullptr;
+            int rowStart = (int)band.runs.size();
+            for (int x = Rows::nextSet(row, 0, cols); x < cols; x = Rows::nextSet(row, x, cols)) {
+                Run run;
+                run.y = y;
+                run.x0 = x;
+                x = Rows::nextClear(row, x, cols);
+                run.x1 = x;
+                run.boundary = 0;
+                run.irregular = false;
+                for (int i = run.x0; i < run.x1; i++) {
+                    if (i != run.x0 && i != run.x1 - 1 && up && Rows::at(up, i) && down && Rows::at(down, i)) continue;
+                    run.boundary++;
+                    run.irregular |= pinch<Rows>(up, row, down, i, cols);
+                }
+                band.parent.push_back((int)band.runs.size());
+                band.runs.push_back(run);
+            }
+            int rowEnd = (int)band.runs.size();
+            if (y > y0) connect(band.runs, band.parent, prevStart, prevEnd, rowStart, rowEnd);
+            else band.firstRowEnd = rowEnd;
+            band.lastRowStart = rowStart;
+            prevStart = rowStart;
+            prevEnd = rowEnd;
+        }
+    }
+
+    // More than one foreground arc around (x, row): the outer contour may
+    // pass through this pixel twice.
+    template <typename Rows, typename Word>
+    static bool pinch(const Word* up, const Word* row, const Word* down, int x, int cols) {
+        bool l = x > 0, r = x + 1 < cols;
+        bool ring[8] = {up && Rows::at(up, x),           up && r && Rows::at(up, x + 1),
+                        r && Rows::at(row, x + 1),       down && r && Rows::at(down, x + 1),
+                        down && Rows::at(down, x),       down && l && Rows::at(down, x - 1),
+                        l && Rows::at(row, x - 1),       up && l && Rows::at(up, x - 1)};
+        int arcs = 0;
+        for (int i = 0; i < 8; i++) arcs += ring[i] && !ring[(i + 7) % 8];
+        return arcs > 1;
+    }
+
+    // Exact outer contour area of blob k: its runs are painted into a padded
+    // scratch mask and traced with findContours.
+    double traceArea(int k, const Stats& s) {
+        scratch_.create(s.y1 - s.y0 + 2, s.x1 - s.x0 + 2, CV_8UC1);
+        scratch_.setTo(cv::Scalar(0));
+        for (size_t i = 0; i < runs_.size(); i++) {
+            if (label_[find((int)i)] != k) continue;
+            const Run& run = runs_[i];
+            std::memset(scratch_.ptr<uchar>(run.y - s.y0 + 1) + run.x0 - s.x0 + 1, 255, run.x1 - run.x0);
+        }
+        cv::findContours(scratch_, contours_, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
+        double area = 0;
+        for (const auto& c : contours_) area = std::max(area, cv::contourArea(c));
+        return area;
+    }
+
+    std::vector<Band> bands_;
+    std::vector<Run> runs_;
+    std::vector<int> parent_, label_;
+    std::vector<Stats> stats_;
+    std::vector<Blob> blobs_;
+    cv::Mat scratch_;
+    std::vector<std::vector<cv::Point>> contours_;
+};
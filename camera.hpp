@@ -0,0 +1,284 @@
+#pragma once
+
+// Raw YUV capture for the native detection path (yuv.hpp). Frames are handed
+// out as views of the backend's own buffers and given back with release()
+// once nothing refers to them any more, so no frame is copied or converted
+// on the way in. V4l2Camera maps the driver's buffers (Linux only);
+// YuvFileCamera plays a raw .yuv dump through the same interface, paced like
+// a camera, for testing without one.
+
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "yuv.hpp"
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/videodev2.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+class YuvCamera {
+public:
+    virtual ~YuvCamera() {}
+
+    virtual bool isOpened() const = 0;
+    virtual YuvFormat format() const = 0;
+    virtual cv::Size size() const = 0;
+
+    // A FramePipeline holds up to three frames at once: the one detection
+    // works on, the published one and the one just captured. Cameras keep
+    // two buffers more than that, so read() never waits on a buffer the
+    // pipeline still holds and a V4L2 driver always has one queued to fill.
+    enum { PIPELINE_HELD = 3, MIN_BUFFERS = PIPELINE_HELD + 2 };
+
+    // Next frame as a view of buffer 'buffer', valid until release(buffer).
+    // At most buffers() - 2 frames may be held at once.
+    virtual bool read(cv::Mat& frame, int& buffer) = 0;
+    virtual void release(int buffer) = 0;
+    virtual int buffers() const = 0;
+
+    const std::string& error() const { return error_; }
+
+protected:
+    std::string error_;
+};
+
+// Raw frames back to back, as written by
+//   ffmpeg -i clip.mp4 -pix_fmt nv12 -f rawvideo clip.yuv
+// fps = 0 reads as fast as the consumer releases buffers.
+class YuvFileCamera : public YuvCamera {
+public:
+    YuvFileCamera(const std::string& path, cv::Size size, YuvFormat format, double fps = 30, int buffers = MIN_BUFFERS)
+        : in_(path, std::ios::binary), size_(size), format_(format), fps_(fps),
+          busy_(std::max<int>(buffers, MIN_BUFFERS), false) {
+        if (!in_) {
+            error_ = "could not open " + path;
+            return;
+        }
+        for (int i = 0; i < (int)busy_.size(); i++) {
+            if (format == YuvFormat::NV12) buffers_.emplace_back(size.height * 3 / 2, size.width, CV_8UC1);
+            else buffers_.emplace_back(size.height, size.width, CV_8UC2);
+        }
+    }
+
+    bool isOpened() const override { return !buffers_.empty(); }
+    YuvFormat format() const override { return format_; }
+    cv::Size size() const override { return size_; }
+    int buffers() const override { return (int)buffers_.size(); }
+
+    bool read(cv::Mat& frame, int& buffer) override {
+        buffer = -1;
+        for (int i = 0; i < (int)busy_.size() && buffer < 0; i++)
+            if (!busy_[i]) buffer = i;
+        if (buffer < 0) {
+            error_ = "every buffer is held by the caller";
+            return false;
+        }
+        cv::Mat& b = buffers_[buffer];
+        if (!in_.read((char*)b.data, b.total() * b.elemSize())) {
+            buffer = -1;
+            return false;
+        }
+        if (fps_ > 0) {
+            auto now = std::chrono::steady_clock::now();
+            if (next_ > now) std::this_thread::sleep_until(next_);
+            else next_ = now;
+            next_ += std::chrono::microseconds((int64_t)(1e6 / fps_));
+        }
+        busy_[buffer] = true;
+        frame = b;
+        return true;
+    }
+
+    void release(int buffer) override {
+        if (buffer >= 0 && buffer < (int)busy_.size()) busy_[buffer] = false;
+    }
+
+private:
+    std::ifstream in_;
+    cv::Size size_;
+    YuvFormat format_;
+    double fps_;
+    std::vector<cv::Mat> buffers_;
+    std::vector<bool> busy_;
+    std::chrono::steady_clock::time_point next_;
+};
+
+#ifdef __linux__
+
+// Memory-mapped V4L2 streaming capture. The driver fills the mapped buffers
+// directly; read() dequeues one and wraps it in a Mat, release() queues it
+// again.
+class V4l2Camera : public YuvCamera {
+public:
+    V4l2Camera(const std::string& device, cv::Size size, YuvFormat format, int fps = 30, int buffers = 6)
+        : format_(format) {
+        fd_ = ::open(device.c_str(), O_RDWR | O_NONBLOCK);
+        if (fd_ < 0) {
+            fail("could not open " + device);
+            return;
+        }
+
+        v4l2_format fmt = {};
+        fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        fmt.fmt.pix.width = size.width;
+        fmt.fmt.pix.height = size.height;
+        fmt.fmt.pix.pixelformat = format == YuvFormat::NV12 ? V4L2_PIX_FMT_NV12 : V4L2_PIX_FMT_YUYV;
+        fmt.fmt.pix.field = V4L2_FIELD_NONE;
+        uint32_t wanted = fmt.fmt.pix.pixelformat;
+        if (xioctl(VIDIOC_S_FMT, &fmt) < 0) {
+            fail("VIDIOC_S_FMT");
+            return;
+        }
+        // The driver picks the nearest size it supports, but not another format
+        if (fmt.fmt.pix.pixelformat != wanted) {
+            error_ = std::string(format == YuvFormat::NV12 ? "NV12" : "YUYV") + " not supported by " + device;
+            close();
+            return;
+        }
+        size_ = cv::Size(fmt.fmt.pix.width, fmt.fmt.pix.height);
+        stride_ = fmt.fmt.pix.bytesperline;
+
+        v4l2_streamparm parm = {};
+        parm.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        parm.parm.capture.timeperframe.numerator = 1;
+        parm.parm.capture.timeperframe.denominator = fps;
+        xioctl(VIDIOC_S_PARM, &parm);   // best effort, not every driver takes it
+
+        v4l2_requestbuffers req = {};
+        req.count = std::max<int>(buffers, MIN_BUFFERS);
+        req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        req.memory = V4L2_MEMORY_MMAP;
+        if (xioctl(VIDIOC_REQBUFS, &req) < 0) {
+            fail("VIDIOC_REQBUFS");
+            return;
+        }
+        if ((int)req.count < MIN_BUFFERS) {
+            error_ = "driver granted only " + std::to_string(req.count) + " buffers";
+            close();
+            return;
+        }
+        for (uint32_t i = 0; i < req.count; i++) {
+            v4l2_buffer buf = {};
+            buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+            buf.memory = V4L2_MEMORY_MMAP;
+            buf.index = i;
+            if (xioctl(VIDIOC_QUERYBUF, &buf) < 0) {
+                fail("VIDIOC_QUERYBUF");
+                return;
+            }
+            void* p = mmap(nullptr, buf.length, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, buf.m.offset);
+            if (p == MAP_FAILED) {
+                fail("mmap");
+                return;
+            }
+            maps_.push_back({p, buf.length});
+            if (xioctl(VIDIOC_QBUF, &buf) < 0) {
+                fail("VIDIOC_QBUF");
+                return;
+            }
+        }
+        v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        if (xioctl(VIDIOC_STREAMON, &type) < 0) {
+            fail("VIDIOC_STREAMON");
+            return;
+        }
+        streaming_ = true;
+    }
+
+    ~V4l2Camera() override { close(); }
+
+    bool isOpened() const override { return streaming_; }
+    YuvFormat format() const override { return format_; }
+    cv::Size size() const override { return size_; }
+    int buffers() const override { return (int)maps_.size(); }
+
+    bool read(cv::Mat& frame, int& buffer) override {
+        buffer = -1;
+        if (!streaming_) return false;
+        v4l2_buffer buf = {};
+        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buf.memory = V4L2_MEMORY_MMAP;
+        while (xioctl(VIDIOC_DQBUF, &buf) < 0) {
+            if (errno != EAGAIN) {
+                error_ = std::string("VIDIOC_DQBUF: ") + strerror(errno);
+                return false;
+            }
+            pollfd pfd = {fd_, POLLIN, 0};
+            if (poll(&pfd, 1, 2000) <= 0) {
+                error_ = "no frame from the camera for 2 s";
+                return false;
+            }
+        }
+        buffer = buf.index;
+        uchar* data = (uchar*)maps_[buffer].first;
+        if (format_ == YuvFormat::NV12) frame = cv::Mat(size_.height * 3 / 2, size_.width, CV_8UC1, data, stride_);
+        else frame = cv::Mat(size_.height, size_.width, CV_8UC2, data, stride_);
+        return true;
+    }
+
+    void release(int buffer) override {
+        if (!streaming_ || buffer < 0 || buffer >= (int)maps_.size()) return;
+        v4l2_buffer buf = {};
+        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buf.memory = V4L2_MEMORY_MMAP;
+        buf.index = buffer;
+        xioctl(VIDIOC_QBUF, &buf);
+    }
+
+private:
+    int xioctl(unsigned long request, void* arg) {
+        int r;
+        do r = ioctl(fd_, request, arg);
+        while (r < 0 && errno == EINTR);
+        return r;
+    }
+
+    void fail(const std::string& what) {
+        error_ = what + ": " + strerror(errno);
+        close();
+    }
+
+    void close() {
+        if (streaming_) {
+            v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+            xioctl(VIDIOC_STREAMOFF, &type);
+            streaming_ = false;
+        }
+        for (auto& m : maps_) munmap(m.first, m.second);
+        maps_.clear();
+        if (fd_ >= 0) ::close(fd_);
+        fd_ = -1;
+    }
+
+    int fd_ = -1;
+    YuvFormat format_;
+    cv::Size size_;
+    size_t stride_ = 0;
+    std::vector<std::pair<void*, size_t>> maps_;
+    bool streaming_ = false;
+};
+
+#endif // __linux__
+
+// A V4L2 device path (/dev/videoN) opens the camera, anything else is read
+// as a raw file.
+inline std::unique_ptr<YuvCamera> openYuvCamera(const std::string& source, cv::Size size, YuvFormat format, int fps) {
+#ifdef __linux__
+    if (source.compare(0, 10, "/dev/video") == 0)
+        return std::unique_ptr<YuvCamera>(new V4l2Camera(source, size, format, fps));
+#endif
+    return std::unique_ptr<YuvCamera>(new YuvFileCamera(source, size, format, fps));
+}
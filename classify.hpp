@@ -0,0 +1,215 @@
+#pragma once
+
+// Multi-class colour classification through one lookup table. Each target
+// class is a named colour region, an HSV box or a histogram of sampled
+// pixels; compile() turns them into a quantized BGR -> class ID table
+// (32 x 32 x 32 cells by default), so a frame is classified with one lookup
+// per pixel however many classes there are. Class 0 is background.
+
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "bitmask.hpp"
+#include "threshold.hpp"
+
+struct ColorClass {
+    std::string name;
+    cv::Scalar lower, upper;    // HSV box; the hue wraps when lower[0] > upper[0]
+    cv::Mat samples;            // or BGR sample pixels (CV_8UC3), when not empty
+    int minSamples = 1;         // samples a cell needs to belong to the class
+};
+
+class ColorClassifier {
+public:
+    // bits per channel of the table index: 5 gives 32x32x32 cells of 8x8x8 colours
+    explicit ColorClassifier(int bits = 5) : bits_(bits) { CV_Assert(bits >= 1 && bits <= 8); }
+
+    int addBand(const std::string& name, const cv::Scalar& lower, const cv::Scalar& upper) {
+        ColorClass c;
+        c.name = name;
+        c.lower = lower;
+        c.upper = upper;
+        classes_.push_back(c);
+        return (int)classes_.size();
+    }
+
+    int addSamples(const std::string& name, const cv::Mat& bgr, int minSamples = 1) {
+        CV_Assert(bgr.type() == CV_8UC3);
+        ColorClass c;
+        c.name = name;
+        c.samples = bgr.clone();
+        c.minSamples = minSamples;
+        classes_.push_back(c);
+        return (int)classes_.size();
+    }
+
+    // Number of target classes; IDs run from 1 to classCount().
+    int classCount() const { return (int)classes_.size(); }
+    const std::string& name(int id) const {
+        static const std::string none = "NONE";
+        return id >= 1 && id <= classCount() ? classes_[id - 1].name : none;
+    }
+
+    // Builds the table. A box claims the cells it covers at least half of, a
+    // sampled class the cells with at least minSamples samples. Where claims
+    // overlap, sampled classes beat boxes, then the larger share or sample
+    // fraction wins, then the earlier class.
+    void compile() {
+        CV_Assert(classCount() < 255);
+        const int cells = 1 << (3 * bits_), shift = 8 - bits_, side = 1 << shift;
+        std::vector<float> best(cells, 0);
+        lut_.assign(cells, 0);
+        static const BgrToMaskRowFn kernel = bgrToMaskRowKernel();
+        for (int k = 0; k < classCount(); k++) {
+            const ColorClass& c = classes_[k];
+            std::vector<float> score(cells, 0);
+            if (!c.samples.empty()) {
+                std::vector<int> hist(cells, 0);
+                for (int y = 0; y < c.samples.rows; y++) {
+                    const uchar* p = c.samples.ptr<uchar>(y);
+                    for (int x = 0; x < c.samples.cols; x++, p += 3) hist[index(p[0], p[1], p[2])]++;
+                }
+                for (int i = 0; i < cells; i++)
+                    if (hist[i] >= c.minSamples) score[i] = 1 + hist[i] / (float)c.samples.total();
+            } else {
+                // Every colour of each cell through the HSV threshold kernel,
+                // one green x red plane of the cell at a time
+                std::vector<HsvBand> bands;
+                if (c.lower[0] > c.upper[0]) {
+                    bands.emplace_back(cv::Scalar(c.lower[0], c.lower[1], c.lower[2]), cv::Scalar(180, c.upper[1], c.upper[2]));
+                    bands.emplace_back(cv::Scalar(0, c.lower[1], c.lower[2]), cv::Scalar(c.upper[0], c.upper[1], c.upper[2]));
+                } else {
+                    bands.emplace_back(c.lower, c.upper);
+                }
+                cv::parallel_for_(cv::Range(0, cells), [&](const cv::Range& r) {
+                    std::vector<uchar> bgr(3 * side * side), hit(side * side);
+                    for (int i = r.start; i < r.end; i++) {
+                        int b0 = (i >> (2 * bits_)) << shift, g0 = ((i >> bits_) & ((1 << bits_) - 1)) << shift;
+                        int r0 = (i & ((1 << bits_) - 1)) << shift, count = 0;
+                        for (int db = 0; db < side; db++) {
+                            uchar* p = bgr.data();
+                            for (int dg = 0; dg < side; dg++)
+                                for (int dr = 0; dr < side; dr++, p += 3) {
+                                    p[0] = (uchar)(b0 + db);
+                                    p[1] = (uchar)(g0 + dg);
+                                    p[2] = (uchar)(r0 + dr);
+                                }
+                            for (const HsvBand& band : bands) {
+                                if (band.empty) continue;
+                                kernel(bgr.data(), hit.data(), side * side, band);
+                                for (int j = 0; j < side * side; j++) count += hit[j] != 0;
+                            }
+                        }
+                        float share = count / (float)(side * side * side);
+                        if (share >= 0.5f) score[i] = share;
+                    }
+                }, cells / 256.0);
+            }
+            for (int i = 0; i < cells; i++)
+                if (score[i] > best[i]) {
+                    best[i] = score[i];
+                    lut_[i] = (uchar)(k + 1);
+                }
+        }
+    }
+
+    bool compiled() const { return !lut_.empty(); }
+
+    int classify(const uchar* bgr) const { return lut_[index(bgr[0], bgr[1], bgr[2])]; }
+
+    // Label image (CV_8UC1) of class IDs, 0 for background.
+    void labels(const cv::Mat& bgr, cv::Mat& labels) const {
+        CV_Assert(bgr.type() == CV_8UC3 && compiled());
+        labels.create(bgr.rows, bgr.cols, CV_8UC1);
+        cv::parallel_for_(cv::Range(0, bgr.rows), [&](const cv::Range& rows) {
+            for (int y = rows.start; y < rows.end; y++) {
+                const uchar* src = bgr.ptr<uchar>(y);
+                uchar* dst = labels.ptr<uchar>(y);
+                for (int x = 0; x < bgr.cols; x++, src += 3) dst[x] = lut_[index(src[0], src[1], src[2])];
+            }
+        }, bgr.total() / (double)(1 << 16));
+    }
+
+    // One packed mask per class (masks[id - 1]) from the same single pass:
+    // each pixel sets its bit in the word of its own class, so the per-pixel
+    // work does not grow with the number of classes.
+    void masks(const cv::Mat& bgr, std::vector<BitMask>& masks) const {
+        CV_Assert(bgr.type() == CV_8UC3 && compiled());
+        const int k = classCount();
+        masks.resize(k);
+        for (BitMask& m : masks) m.create(bgr.rows, bgr.cols);
+        cv::parallel_for_(cv::Range(0, bgr.rows), [&](const cv::Range& rows) {
+            uint64_t words[256];
+            for (int y = rows.start; y < rows.end; y++) {
+                const uchar* src = bgr.ptr<uchar>(y);
+                for (int x = 0; x < bgr.cols; x += 64) {
+                    int n = std::min(64, bgr.cols - x);
+                    std::fill(words, words + k + 1, 0);
+                    for (int i = 0; i < n; i++, src += 3) words[lut_[index(src[0], src[1], src[2])]] |= 1ull << i;
+                    for (int c = 0; c < k; c++) masks[c].row(y)[x / 64] = words[c + 1];
+                }
+            }
+        }, bgr.total() / (double)(1 << 16));
+    }
+
+private:
+    int index(int b, int g, int r) const {
+        int shift = 8 - bits_;
+        return ((b >> shift) << (2 * bits_)) | ((g >> shift) << bits_) | (r >> shift);
+    }
+
+    int bits_;
+    std::vector<ColorClass> classes_;
+    std::vector<uchar> lut_;
+};
+
+// Reads classes from a text file, one per line:
+//   NAME hmin smin vmin hmax smax vmax     HSV box (hue 0-180)
+//   NAME samples.png [minSamples]          every pixel of the image is a sample
+// Blank lines and lines starting with # are skipped. Returns the number of
+// classes added.
+inline int loadColorClasses(const std::string& path, ColorClassifier& classifier) {
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "Warning: could not read classes from " << path << std::endl;
+        return 0;
+    }
+    int added = 0;
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream ss(line);
+        std::string name, first;
+        if (!(ss >> name) || name[0] == '#' || !(ss >> first)) continue;
+        double v[6];
+        std::istringstream num(first);
+        if (num >> v[0] && ss >> v[1] >> v[2] >> v[3] >> v[4] >> v[5]) {
+            classifier.addBand(name, cv::Scalar(v[0], v[1], v[2]), cv::Scalar(v[3], v[4], v[5]));
+            added++;
+            continue;
+        }
+        cv::Mat samples = cv::imread(first);
+        if (samples.empty()) {
+            std::cerr << "Warning: bad class line: " << line << std::endl;
+            continue;
+        }
+        int minSamples = 1;
+        std::istringstream rest(line);
+        rest >> name >> first >> minSamples;
+        classifier.addSamples(name, samples, std::max(minSamples, 1));
+        added++;
+    }
+    return added;
+}
+
+// The classes of the live programs, compiled: those in 'path', or the blue
+// band when there is no file or it has none.
+inline void loadTargetClasses(const std::string& path, ColorClassifier& classifier) {
+    if (path.empty() || !loadColorClasses(path, classifier))
+        classifier.addBand("BLUE", cv::Scalar(100, 150, 0), cv::Scalar(140, 255, 255));
+    classifier.compile();
+}
@@ -0,0 +1,195 @@
+#pragma once
+
+// Frame conditioning in one pass. Replaces
+//     flip(frame, frame, 1); resize(frame, frame, size);
+//     display = frame.clone();
+//     overlay = tint; addWeighted(overlay, 0.3, display, 0.7, 0, display);
+//     line(display, (0, y), (cols, y), black) for every 4th row
+// with a resize into a scratch image followed by a single row-band pass that
+// writes the mirrored frame (for detection) and the tinted, scanlined display
+// image at the same time. The output is bit-exact with the sequence above.
+
+#include <opencv2/opencv.hpp>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#ifndef ADS_X86_SIMD
+#define ADS_X86_SIMD 1
+#endif
+#endif
+
+struct ConditionConfig {
+    cv::Size size;                  // empty = keep the capture size
+    bool mirror = true;
+    bool shade = true;              // false = only the frame, no display image
+    cv::Scalar tint{0, 20, 0};
+    double tintWeight = 0.3;        // addWeighted(tint, tintWeight, frame, frameWeight, 0)
+    double frameWeight = 0.7;
+    int scanlineStep = 4;           // every n-th row is blacked out, 0 = none
+};
+
+inline void mirrorRowScalar(const uchar* src, uchar* dst, int n) {
+    for (int x = 0; x < n; x++) {
+        const uchar* s = src + 3 * (n - 1 - x);
+        dst[3 * x] = s[0];
+        dst[3 * x + 1] = s[1];
+        dst[3 * x + 2] = s[2];
+    }
+}
+
+#ifdef ADS_X86_SIMD
+
+// Shuffle masks reversing a block of 16 BGR pixels held in three registers:
+// output register o takes its bytes from input register i through mask [o][i].
+struct MirrorMasks {
+    alignas(16) uchar m[3][3][16];
+    MirrorMasks() {
+        for (int o = 0; o < 3; o++)
+            for (int i = 0; i < 3; i++)
+                for (int j = 0; j < 16; j++) {
+                    int out = o * 16 + j;
+                    int in = 3 * (15 - out / 3) + out % 3;
+                    m[o][i][j] = in / 16 == i ? (uchar)(in % 16) : 0x80;
+                }
+    }
+};
+
+__attribute__((target("ssse3")))
+inline void mirrorRowSsse3(const uchar* src, uchar* dst, int n) {
+    static const MirrorMasks masks;
+    int x = 0;
+    for (; x + 16 <= n; x += 16) {
+        const uchar* s = src + 3 * (n - 16 - x);
+        __m128i in[3] = {_mm_loadu_si128((const __m128i*)s), _mm_loadu_si128((const __m128i*)(s + 16)),
+                         _mm_loadu_si128((const __m128i*)(s + 32))};
+        for (int o = 0; o < 3; o++) {
+            __m128i v = _mm_setzero_si128();
+            for (int i = 0; i < 3; i++)
+                v = _mm_or_si128(v, _mm_shuffle_epi8(in[i], _mm_load_si128((const __m128i*)masks.m[o][i])));
+            _mm_storeu_si128((__m128i*)(dst + 3 * x + 16 * o), v);
+        }
+    }
+    mirrorRowScalar(src, dst + 3 * x, n - x);
+}
+
+#endif // ADS_X86_SIMD
+
+typedef void (*MirrorRowFn)(const uchar*, uchar*, int);
+
+inline MirrorRowFn mirrorRowKernel() {
+#ifdef ADS_X86_SIMD
+    if (cv::checkHardwareSupport(CV_CPU_SSSE3)) return mirrorRowSsse3;
+#endif
+    return mirrorRowScalar;
+}
+
+class FrameConditioner {
+public:
+    explicit FrameConditioner(ConditionConfig cfg = ConditionConfig()) : cfg_(cfg) {
+        // The tint table comes from addWeighted itself, so it rounds exactly
+        // like the full-frame call it replaces.
+        cv::Mat ramp(1, 256, CV_8UC3), lut;
+        for (int v = 0; v < 256; v++) ramp.at<cv::Vec3b>(0, v) = cv::Vec3b(v, v, v);
+        cv::Mat tint(ramp.size(), CV_8UC3, cfg_.tint);
+        cv::addWeighted(tint, cfg_.tintWeight, ramp, cfg_.frameWeight, 0, lut);
+        for (int v = 0; v < 256; v++)
+            for (int c = 0; c < 3; c++) lut_[c][v] = lut.at<cv::Vec3b>(0, v)[c];
+    }
+
+    // 'frame' gets the mirrored, scaled capture; 'display' the same image
+    // with the tint and scanlines applied. Both are reused between calls.
+    void operator()(const cv::Mat& src, cv::Mat& frame, cv::Mat& display) {
+        CV_Assert(src.type() == CV_8UC3);
+        cv::Size size = cfg_.size.empty() ? src.size() : cfg_.size;
+
+        // Mirroring after the resize gives the same pixels as mirroring
+        // before it only when the horizontal sample positions land on the
+        // same fixed-point weights, i.e. when the scale is a dyadic fraction.
+        const cv::Mat* scaled = &src;
+        bool mirror = cfg_.mirror;
+        if (size != src.size()) {
+            if (mirror && !dyadic(src.cols, size.width)) {
+                cv::flip(src, flipped_, 1);
+                cv::resize(flipped_, scaled_, size);
+                mirror = false;
+            } else {
+                cv::resize(src, scaled_, size);
+            }
+            scaled = &scaled_;
+        } else if (mirror && src.data == frame.data) {
+            src.copyTo(scaled_);   // mirroring cannot run in place
+            scaled = &scaled_;
+        }
+
+        frame.create(size, CV_8UC3);
+        if (cfg_.shade) display.create(size, CV_8UC3);
+        static const MirrorRowFn mirrorRow = mirrorRowKernel();
+        const cv::Mat& in = *scaled;
+        cv::parallel_for_(cv::Range(0, size.height), [&](const cv::Range& rows) {
+            for (int y = rows.start; y < rows.end; y++) {
+                uchar* f = frame.ptr<uchar>(y);
+                if (mirror) mirrorRow(in.ptr<uchar>(y), f, size.width);
+                else if (f != in.ptr<uchar>(y)) std::memcpy(f, in.ptr<uchar>(y), size.width * 3);
+                if (!cfg_.shade) continue;
+                if (cfg_.scanlineStep > 0 && y % cfg_.scanlineStep == 0) {
+                    std::memset(display.ptr<uchar>(y), 0, size.width * 3);
+                    continue;
+                }
+                uchar* d = display.ptr<uchar>(y);
+                for (int x = 0; x < size.width * 3; x += 3) {
+                    d[x] = lut_[0][f[x]];
+                    d[x + 1] = lut_[1][f[x + 1]];
+                    d[x + 2] = lut_[2][f[x + 2]];
+                }
+            }
+        }, size.area() / (double)(1 << 16));
+    }
+
+    const ConditionConfig& config() const { return cfg_; }
+
+private:
+    static bool dyadic(int from, int to) {
+        int q = to / std::gcd(from, to);
+        return (q & (q - 1)) == 0;
+    }
+
+    ConditionConfig cfg_;
+    uchar lut_[3][256];
+    cv::Mat scaled_, flipped_;
+};
+
+// Region r of a frame of size 'from' in a frame of size 'to', mirrored when
+// 'mirror' is set: capture <-> conditioned frame, either way round. Grows to
+// whole pixels and is clipped to the target frame.
+inline cv::Rect mapRect(const cv::Rect& r, cv::Size from, cv::Size to, bool mirror) {
+    double sx = (double)to.width / from.width, sy = (double)to.height / from.height;
+    int x0 = (int)std::floor(r.x * sx), x1 = (int)std::ceil((r.x + r.width) * sx);
+    int y0 = (int)std::floor(r.y * sy), y1 = (int)std::ceil((r.y + r.height) * sy);
+    if (mirror) {
+        int m = to.width - x1;
+        x1 = to.width - x0;
+        x0 = m;
+    }
+    return cv::Rect(x0, y0, x1 - x0, y1 - y0) & cv::Rect(cv::Point(), to);
+}
+
+// The sequence FrameConditioner replaces, kept for benchmarking and checks.
+inline void shadeLegacy(const cv::Mat& frame, const ConditionConfig& cfg, cv::Mat& display) {
+    display = frame.clone();
+    cv::Mat overlay;
+    display.copyTo(overlay);
+    cv::rectangle(overlay, cv::Point(0, 0), cv::Point(display.cols, display.rows), cfg.tint, cv::FILLED);
+    cv::addWeighted(overlay, cfg.tintWeight, display, cfg.frameWeight, 0, display);
+    for (int y = 0; cfg.scanlineStep > 0 && y < display.rows; y += cfg.scanlineStep)
+        cv::line(display, cv::Point(0, y), cv::Point(display.cols, y), cv::Scalar(0, 0, 0), 1);
+}
+
+inline void conditionLegacy(const cv::Mat& src, const ConditionConfig& cfg, cv::Mat& frame, cv::Mat& display) {
+    if (cfg.mirror) cv::flip(src, frame, 1);
+    else src.copyTo(frame);
+    if (!cfg.size.empty()) cv::resize(frame, frame, cfg.size);
+    if (cfg.shade) shadeLegacy(frame, cfg, display);
+}
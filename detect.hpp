@@ -0,0 +1,56 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+#include "bitmask.hpp"
+#include "blobs.hpp"
+
+// Largest blob of a binary mask (cv::Mat or BitMask), by outer contour area.
+// 'offset' is the position of the mask inside the full frame, so the returned
+// box is in frame coordinates. Returns false when there is no blob bigger
+// than minArea.
+template <typename Mask>
+inline bool largestBlob(const Mask& mask, cv::Point offset, double minArea, cv::Rect& box,
+                        BlobExtractor& extractor) {
+    double maxArea = 0;
+    int idx = -1;
+    const std::vector<Blob>& blobs = extractor.extract(mask, offset, minArea);
+    for (int i = 0; i < (int)blobs.size(); i++)
+        if (blobs[i].area > maxArea) { maxArea = blobs[i].area; idx = i; }
+    if (idx == -1) return false;
+    box = blobs[idx].box;
+    return true;
+}
+
+// Appends the bounding box of every blob bigger than minArea.
+template <typename Mask>
+inline void allBlobs(const Mask& mask, cv::Point offset, double minArea, std::vector<cv::Rect>& boxes,
+                     BlobExtractor& extractor) {
+    for (const Blob& b : extractor.extract(mask, offset, minArea)) boxes.push_back(b.box);
+}
+
+// allBlobs over one mask per colour class (masks[id - 1], as from
+// ColorClassifier::masks), appending the class ID of every box to 'classes'.
+inline void classBlobs(const std::vector<BitMask>& masks, cv::Point offset, double minArea,
+                       std::vector<cv::Rect>& boxes, std::vector<int>& classes, BlobExtractor& extractor) {
+    for (int c = 0; c < (int)masks.size(); c++) {
+        allBlobs(masks[c], offset, minArea, boxes, extractor);
+        classes.resize(boxes.size(), c + 1);
+    }
+}
+
+// largestBlob done the original way, tracing every contour with findContours.
+// Kept for benchmarking and checks.
+inline bool largestContour(const cv::Mat& mask, cv::Point offset, double minArea, cv::Rect& box,
+                           std::vector<std::vector<cv::Point>>& contours) {
+    cv::findContours(mask, contours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE, offset);
+    double maxArea = 0;
+    int idx = -1;
+    for (int i = 0; i < (int)contours.size(); i++) {
+        double a = cv::contourArea(contours[i]);
+        if (a > maxArea) { maxArea = a; idx = i; }
+    }
+    if (idx == -1 || maxArea <= minArea) return false;
+    box = cv::boundingRect(contours[idx]);
+    return true;
+}
@@ -0,0 +1,341 @@
+#pragma once
+
+// Engagement engine: any number of interceptors flying proportional
+// navigation against the tracked targets, on a fixed simulation timestep
+// that does not depend on the render rate. Interceptor and target state is
+// kept as structure-of-arrays, and one step is a branch-free loop over
+// contiguous floats the compiler can vectorize; launches, hits and losses are
+// handled in a scalar pass afterwards.
+//
+// Everything random (launch heading error, seeker noise) is a hash of the
+// seed, the interceptor serial number and the step, so the same seed and the
+// same sequence of observe / launch / step calls reproduce a run exactly.
+
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+struct EngagementConfig {
+    double dt = 1.0 / 240;              // simulation step, s
+    int maxStepsPerAdvance = 60;        // catch-up limit of advance(); the rest of the time is dropped
+    float speed = 900;                  // interceptor speed, px/s
+    float navGain = 4;                  // proportional navigation constant N
+    float maxAccel = 6000;              // lateral acceleration limit, px/s^2
+    float killRadius = 20;              // closest approach that counts as a hit, px
+    float maxFlightTime = 3;            // s before an interceptor is counted as a miss
+    float launchDispersion = 0.05f;     // max heading error at launch, rad
+    float seekerNoise = 0.05f;          // max line-of-sight rate error, rad/s
+    float targetTimeout = 0.5f;         // s without an observation before a target is dropped
+    float velocitySmoothing = 0.5f;     // weight of a new target velocity measurement
+    int roundsPerLauncher = 1;
+    float reloadTime = 4;               // s to refill an empty launcher
+    std::vector<cv::Point2f> launchers; // launcher positions, px
+    int capacity = 4096;                // interceptors and targets reserved up front
+};
+
+struct EngageEvent {
+    enum Type { LAUNCH, HIT, MISS, LOST, RELOADED };
+    Type type;
+    int64_t step;
+    int launcher;       // -1 for none
+    int target;         // target id, -1 for none
+    cv::Point2f pos;
+};
+
+// Interceptors in flight, one array per field; index i is one interceptor.
+// The order changes when interceptors are removed.
+struct InterceptorArrays {
+    std::vector<float> x, y, vx, vy, age;
+    std::vector<int> target;    // target slot
+    std::vector<int> launcher;
+    std::vector<uint32_t> serial;
+
+    int size() const { return (int)x.size(); }
+};
+
+// Uniform in [-1, 1), from a counter-based hash (splitmix64 finalizer), so
+// the value does not depend on the order interceptors are processed in.
+inline float hashUniform(uint64_t seed, uint64_t a, uint64_t b) {
+    uint64_t z = seed + a * 0x9E3779B97F4A7C15ull + b * 0xC2B2AE3D27D4EB4Full;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    z ^= z >> 31;
+    return (float)((z >> 40) * (1.0 / (1 << 23))) - 1.0f;
+}
+
+class EngagementEngine {
+public:
+    explicit EngagementEngine(EngagementConfig cfg, uint64_t seed = 1) : cfg_(cfg) {
+        CV_Assert(cfg_.dt > 0 && !cfg_.launchers.empty());
+        reserve(cfg_.capacity);
+        events_.reserve(256);
+        reset(seed);
+    }
+
+    void reset(uint64_t seed) {
+        seed_ = seed;
+        step_ = 0;
+        accumulator_ = 0;
+        nextSerial_ = 0;
+        for (auto* v : {&in_.x, &in_.y, &in_.vx, &in_.vy, &in_.age}) v->clear();
+        in_.target.clear(); in_.launcher.clear(); in_.serial.clear();
+        tid_.clear(); tx_.clear(); ty_.clear(); tvx_.clear(); tvy_.clear();
+        obsX_.clear(); obsY_.clear(); seen_.clear();
+        rounds_.assign(cfg_.launchers.size(), cfg_.roundsPerLauncher);
+        reloadLeft_.assign(cfg_.launchers.size(), 0.f);
+        events_.clear();
+    }
+
+    // Reports where target 'id' (>= 0) is now; its velocity is estimated
+    // from consecutive observations. Targets that stop being observed are
+    // dropped after targetTimeout and their interceptors are lost.
+    void observe(int id, cv::Point2f pos) {
+        CV_Assert(id >= 0);
+        int s = slotOf(id);
+        if (s < 0) {
+            tid_.push_back(id);
+            tx_.push_back(pos.x); ty_.push_back(pos.y);
+            tvx_.push_back(0); tvy_.push_back(0);
+            obsX_.push_back(pos.x); obsY_.push_back(pos.y);
+            seen_.push_back(step_);
+            return;
+        }
+        float age = (float)((step_ - seen_[s]) * cfg_.dt);
+        if (age > 0) {
+            float w = cfg_.velocitySmoothing;
+            tvx_[s] += w * ((pos.x - obsX_[s]) / age - tvx_[s]);
+            tvy_[s] += w * ((pos.y - obsY_[s]) / age - tvy_[s]);
+        }
+        tx_[s] = obsX_[s] = pos.x;
+        ty_[s] = obsY_[s] = pos.y;
+        seen_[s] = step_;
+    }
+
+    // Fires one round at target 'id' from the first loaded launcher. Returns
+    // the launcher, or -1 when none is loaded or the target is unknown.
+    int launch(int id) {
+        int s = slotOf(id);
+        if (s < 0) return -1;
+        int l = 0;
+        while (l < (int)rounds_.size() && rounds_[l] == 0) l++;
+        if (l == (int)rounds_.size()) return -1;
+        if (--rounds_[l] == 0) reloadLeft_[l] = cfg_.reloadTime;
+
+        uint32_t serial = nextSerial_++;
+        cv::Point2f from = cfg_.launchers[l];
+        float heading = std::atan2(ty_[s] - from.y, tx_[s] - from.x) +
+                        cfg_.launchDispersion * hashUniform(seed_, serial, ~0ull);
+        in_.x.push_back(from.x);
+        in_.y.push_back(from.y);
+        in_.vx.push_back(cfg_.speed * std::cos(heading));
+        in_.vy.push_back(cfg_.speed * std::sin(heading));
+        in_.age.push_back(0);
+        in_.target.push_back(s);
+        in_.launcher.push_back(l);
+        in_.serial.push_back(serial);
+        events_.push_back({EngageEvent::LAUNCH, step_, l, id, from});
+        return l;
+    }
+
+    // Runs as many fixed steps as fit into the elapsed wall-clock time
+    // (at most maxStepsPerAdvance); the remainder carries over.
+    int advance(double seconds) {
+        accumulator_ += seconds;
+        int n = 0;
+        while (accumulator_ >= cfg_.dt && n < cfg_.maxStepsPerAdvance) {
+            step();
+            accumulator_ -= cfg_.dt;
+            n++;
+        }
+        if (n == cfg_.maxStepsPerAdvance) accumulator_ = std::min(accumulator_, cfg_.dt);
+        return n;
+    }
+
+    void step() {
+        const float dt = (float)cfg_.dt;
+
+        // Launchers refill once empty
+        for (size_t l = 0; l < rounds_.size(); l++) {
+            if (rounds_[l] != 0 || (reloadLeft_[l] -= dt) > 0) continue;
+            rounds_[l] = cfg_.roundsPerLauncher;
+            events_.push_back({EngageEvent::RELOADED, step_, (int)l, -1, cfg_.launchers[l]});
+        }
+
+        // Stale targets go first, and the interceptors chasing them with them
+        int64_t timeout = (int64_t)std::ceil(cfg_.targetTimeout / cfg_.dt);
+        for (int s = (int)tid_.size() - 1; s >= 0; s--)
+            if (step_ - seen_[s] > timeout) removeTarget(s);
+        for (int i = in_.size() - 1; i >= 0; i--) {
+            if (in_.target[i] >= 0) continue;
+            events_.push_back({EngageEvent::LOST, step_, in_.launcher[i], -1, cv::Point2f(in_.x[i], in_.y[i])});
+            removeInterceptor(i);
+        }
+
+        // Gather the state of each interceptor's target next to it
+        int n = in_.size();
+        resize(n);
+        for (int i = 0; i < n; i++) {
+            int s = in_.target[i];
+            gx_[i] = tx_[s]; gy_[i] = ty_[s];
+            gvx_[i] = tvx_[s]; gvy_[i] = tvy_[s];
+            noise_[i] = cfg_.seekerNoise * hashUniform(seed_, in_.serial[i], step_);
+        }
+        guide(n, dt);
+
+        for (size_t s = 0; s < tid_.size(); s++) {
+            tx_[s] += tvx_[s] * dt;
+            ty_[s] += tvy_[s] * dt;
+        }
+
+        // Hits and misses leave the arrays
+        for (int i = n - 1; i >= 0; i--) {
+            if (hit_[i]) {
+                events_.push_back({EngageEvent::HIT, step_, in_.launcher[i], tid_[in_.target[i]],
+                                   cv::Point2f(in_.x[i], in_.y[i])});
+                removeInterceptor(i);
+            } else if (in_.age[i] > cfg_.maxFlightTime) {
+                events_.push_back({EngageEvent::MISS, step_, in_.launcher[i], tid_[in_.target[i]],
+                                   cv::Point2f(in_.x[i], in_.y[i])});
+                removeInterceptor(i);
+            }
+        }
+        step_++;
+    }
+
+    const InterceptorArrays& interceptors() const { return in_; }
+
+    // Events since the last clearEvents(), in the order they happened.
+    const std::vector<EngageEvent>& events() const { return events_; }
+    void clearEvents() { events_.clear(); }
+
+    int launcherCount() const { return (int)rounds_.size(); }
+    int rounds(int l) const { return rounds_[l]; }
+    float reloadLeft(int l) const { return rounds_[l] ? 0.f : std::max(reloadLeft_[l], 0.f); }
+    cv::Point2f launcherPos(int l) const { return cfg_.launchers[l]; }
+
+    int targetCount() const { return (int)tid_.size(); }
+    int64_t steps() const { return step_; }
+    double time() const { return step_ * cfg_.dt; }
+    const EngagementConfig& config() const { return cfg_; }
+
+private:
+    // One PN step for interceptors [0, n). The commanded acceleration is
+    // N * closing speed * line-of-sight rate, normal to the velocity; speed
+    // stays constant. A hit is a closest approach within killRadius at any
+    // point of the step, so fast interceptors cannot tunnel through.
+    void guide(int n, float dt) {
+        float* __restrict x = in_.x.data();
+        float* __restrict y = in_.y.data();
+        float* __restrict vx = in_.vx.data();
+        float* __restrict vy = in_.vy.data();
+        float* __restrict age = in_.age.data();
+        const float* __restrict gx = gx_.data();
+        const float* __restrict gy = gy_.data();
+        const float* __restrict gvx = gvx_.data();
+        const float* __restrict gvy = gvy_.data();
+        const float* __restrict noise = noise_.data();
+        uint8_t* __restrict hit = hit_.data();
+        const float gain = cfg_.navGain, amax = cfg_.maxAccel, speed = cfg_.speed;
+        const float kill2 = cfg_.killRadius * cfg_.killRadius;
+
+        for (int i = 0; i < n; i++) {
+            float rx = gx[i] - x[i], ry = gy[i] - y[i];
+            float wx = gvx[i] - vx[i], wy = gvy[i] - vy[i];
+            float r2 = std::max(rx * rx + ry * ry, 1e-6f);
+            float losRate = (rx * wy - ry * wx) / r2 + noise[i];
+            float closing = -(rx * wx + ry * wy) / std::sqrt(r2);
+            float a = std::min(std::max(gain * closing * losRate, -amax), amax);
+
+            float v = std::sqrt(vx[i] * vx[i] + vy[i] * vy[i]);
+            float ax = -vy[i] / v * a, ay = vx[i] / v * a;
+            float nvx = vx[i] + ax * dt, nvy = vy[i] + ay * dt;
+            float k = speed / std::sqrt(nvx * nvx + nvy * nvy);
+            nvx *= k;
+            nvy *= k;
+
+            // closest approach over the step, relative motion r + w t
+            wx = gvx[i] - nvx;
+            wy = gvy[i] - nvy;
+            float w2 = std::max(wx * wx + wy * wy, 1e-6f);
+            float t = std::min(std::max(-(rx * wx + ry * wy) / w2, 0.f), dt);
+            float dx = rx + wx * t, dy = ry + wy * t;
+            hit[i] = dx * dx + dy * dy < kill2;
+
+            x[i] += nvx * dt;
+            y[i] += nvy * dt;
+            vx[i] = nvx;
+            vy[i] = nvy;
+            age[i] += dt;
+        }
+    }
+
+    // Slot of target 'id', or -1. Track IDs only ever grow, so a table
+    // indexed by ID would grow with the session; the live targets are few
+    // enough to search.
+    int slotOf(int id) const {
+        for (size_t s = 0; s < tid_.size(); s++)
+            if (tid_[s] == id) return (int)s;
+        return -1;
+    }
+
+    // Swap-with-last removal; interceptors of the moved target follow it.
+    void removeTarget(int s) {
+        int last = (int)tid_.size() - 1;
+        for (int i = 0; i < in_.size(); i++) {
+            if (in_.target[i] == s) in_.target[i] = -1;
+            else if (in_.target[i] == last) in_.target[i] = s;
+        }
+        if (s != last) {
+            tid_[s] = tid_[last]; tx_[s] = tx_[last]; ty_[s] = ty_[last];
+            tvx_[s] = tvx_[last]; tvy_[s] = tvy_[last];
+            obsX_[s] = obsX_[last]; obsY_[s] = obsY_[last]; seen_[s] = seen_[last];
+        }
+        tid_.pop_back(); tx_.pop_back(); ty_.pop_back(); tvx_.pop_back(); tvy_.pop_back();
+        obsX_.pop_back(); obsY_.pop_back(); seen_.pop_back();
+    }
+
+    void removeInterceptor(int i) {
+        int last = in_.size() - 1;
+        in_.x[i] = in_.x[last]; in_.y[i] = in_.y[last];
+        in_.vx[i] = in_.vx[last]; in_.vy[i] = in_.vy[last];
+        in_.age[i] = in_.age[last]; in_.target[i] = in_.target[last];
+        in_.launcher[i] = in_.launcher[last]; in_.serial[i] = in_.serial[last];
+        in_.x.pop_back(); in_.y.pop_back(); in_.vx.pop_back(); in_.vy.pop_back();
+        in_.age.pop_back(); in_.target.pop_back(); in_.launcher.pop_back(); in_.serial.pop_back();
+    }
+
+    void reserve(int n) {
+        for (auto* v : {&in_.x, &in_.y, &in_.vx, &in_.vy, &in_.age, &gx_, &gy_, &gvx_, &gvy_, &noise_,
+                        &tx_, &ty_, &tvx_, &tvy_, &obsX_, &obsY_})
+            v->reserve(n);
+        in_.target.reserve(n); in_.launcher.reserve(n); in_.serial.reserve(n);
+        hit_.reserve(n); tid_.reserve(n); seen_.reserve(n);
+    }
+
+    // Per-step scratch, one entry per interceptor
+    void resize(int n) {
+        for (auto* v : {&gx_, &gy_, &gvx_, &gvy_, &noise_}) v->resize(n);
+        hit_.resize(n);
+    }
+
+    EngagementConfig cfg_;
+    uint64_t seed_ = 1;
+    int64_t step_ = 0;
+    double accumulator_ = 0;
+    uint32_t nextSerial_ = 0;
+
+    InterceptorArrays in_;
+    std::vector<float> gx_, gy_, gvx_, gvy_, noise_;
+    std::vector<uint8_t> hit_;
+
+    // Targets, indexed by slot; tid_ holds the target id of each slot
+    std::vector<int> tid_;
+    std::vector<float> tx_, ty_, tvx_, tvy_, obsX_, obsY_;
+    std::vector<int64_t> seen_;
+
+    std::vector<int> rounds_;
+    std::vector<float> reloadLeft_;
+    std::vector<EngageEvent> events_;
+};
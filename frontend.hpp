@@ -0,0 +1,208 @@
+#pragma once
+
+// Detection and tracking front end of the live programs (1, 2): capture and
+// conditioning on the capture thread, colour classification, blob
+// extraction and the TrackManager on the detection thread. The programs
+// only render what it delivers. TelemetryPanel is the stage-timing block
+// both of them draw under the event log.
+
+#include <opencv2/opencv.hpp>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "replay.hpp"
+#include "condition.hpp"
+#include "classify.hpp"
+#include "detect.hpp"
+#include "tiled.hpp"
+#include "motion.hpp"
+#include "tracks.hpp"
+#include "pipeline.hpp"
+#include "hud.hpp"
+#include "journal.hpp"
+#include "telemetry.hpp"
+
+// Filled by the detection thread for every frame it processes
+struct Detected {
+    cv::Mat frame, display;
+    int64_t seq = 0, captureTick = 0;
+    std::vector<Track> tracks;
+    int engaged = -1;   // index into tracks
+};
+
+class TargetFrontEnd {
+public:
+    explicit TargetFrontEnd(const ReplayOptions& opt)
+        : opt_(opt), cc_(conditionConfig()), condition_(cc_), incremental_(incrementalConfig(opt)) {
+        // Target colour classes, compiled into one lookup table: the blue
+        // band, or the regions listed in --classes <file>
+        loadTargetClasses(opt.classesPath, classifier_);
+    }
+
+    const ColorClassifier& classifier() const { return classifier_; }
+    cv::Size size() const { return cc_.size; }
+
+    // Capture thread. Mirror, scale, tint and scanlines in one pass; with
+    // --full-res detection keeps the capture frame and the conditioned copy
+    // is only shown.
+    bool capture(cv::VideoCapture& cap, FramePacket& p) {
+        {
+            ADS_TIME_STAGE(CAPTURE);
+            cap >> (opt_.fullResolution ? p.frame : raw_);
+        }
+        if (opt_.fullResolution) {
+            if (p.frame.empty()) return false;
+            ADS_TIME_STAGE(CONDITION);
+            condition_(p.frame, scaled_, p.display);
+            return true;
+        }
+        if (raw_.empty()) return false;
+        ADS_TIME_STAGE(CONDITION);
+        condition_(raw_, p.frame, p.display);
+        return true;
+    }
+
+    // Detection thread. Full frame when looking for new targets, otherwise
+    // only the windows around the tracks. Windows and tracks live in the
+    // 1024x600 view; with --full-res the search runs on the capture frame
+    // and windows and boxes are mapped between the two.
+    void detect(FramePacket& in, Detected& out) {
+        ADS_LAPS(laps);
+        detections_.clear();
+        detectionClasses_.clear();
+        const bool mapped = opt_.fullResolution;
+        const cv::Size view = cc_.size, source = in.frame.size();
+        const double minArea = MIN_AREA * source.area() / view.area();
+        for (const cv::Rect& window : tracks_.predict(view)) {
+            cv::Rect region = mapped ? mapRect(window, view, source, cc_.mirror) : window;
+            size_t first = detections_.size();
+            if (opt_.incremental && window == cv::Rect(cv::Point(), view)) {
+                // a full search classifies only the tiles that moved or hold a track
+                active_.clear();
+                for (const Track& t : tracks_.tracks()) {
+                    cv::Rect a(t.box.x - 40, t.box.y - 40, t.box.width + 80, t.box.height + 80);
+                    active_.push_back(mapped ? mapRect(a, view, source, cc_.mirror) : a);
+                }
+                incremental_.detect(in.frame, classifier_, active_, minArea, detections_, detectionClasses_);
+                ADS_LAP(laps, THRESHOLD);
+            } else if (mapped) {
+                // the window at capture resolution, searched band by band
+                tiled_.mask(in.frame(region), classifier_, false);
+                ADS_LAP(laps, THRESHOLD);
+                tiled_.extract(region.tl(), minArea, detections_, detectionClasses_);
+                ADS_LAP(laps, BLOBS);
+            } else {
+                // one lookup per pixel gives the masks of every class
+                classifier_.masks(in.frame(region), masks_);
+                ADS_LAP(laps, THRESHOLD);
+                classBlobs(masks_, region.tl(), minArea, detections_, detectionClasses_, blobs_);
+                ADS_LAP(laps, BLOBS);
+            }
+            if (mapped)
+                for (size_t k = first; k < detections_.size(); k++)
+                    detections_[k] = mapRect(detections_[k], source, view, cc_.mirror);
+        }
+        tracks_.update(detections_, detectionClasses_);
+        for (int n = cycleRequests_.exchange(0); n > 0; n--) tracks_.cycleEngaged();
+        ADS_LAP(laps, TRACKING);
+
+        out.tracks = tracks_.tracks();
+        const Track* t = tracks_.engaged();
+        out.engaged = t ? (int)(t - tracks_.tracks().data()) : -1;
+        std::swap(in.frame, out.frame);
+        std::swap(in.display, out.display);
+    }
+
+    // --journal: opens the session journal with the class names of the
+    // classifier; 'seed' is the engagement seed, 0 for none. A no-op without
+    // --journal.
+    bool openJournal(JournalWriter& journal, uint64_t seed) const {
+        if (opt_.journalPath.empty()) return false;
+        std::vector<std::string> classNames;
+        for (int c = 1; c <= classifier_.classCount(); c++) classNames.push_back(classifier_.name(c));
+        return journal.open(opt_.journalPath, opt_.journalFrames, seed, classNames);
+    }
+
+    // Any thread: the engaged track moves on at the next detection step.
+    void cycleEngaged() { cycleRequests_++; }
+
+    // Printed on exit, after the pipeline has stopped.
+    void printSummary(const PipelineStats& stats) const {
+        std::cout << "captured " << stats.captured << ", dropped before detection " << stats.captureDropped
+                  << ", dropped before display " << stats.detectDropped
+                  << ", mean capture-to-display " << stats.latencyMs << " ms" << std::endl;
+        if (opt_.incremental)
+            std::cout << "tiles skipped " << incremental_.skippedFraction() * 100 << " % of " << incremental_.tiles()
+                      << std::endl;
+    }
+
+private:
+    static constexpr double MIN_AREA = 400;   // px in the 1024x600 detection frame
+
+    static ConditionConfig conditionConfig() {
+        ConditionConfig cc;
+        cc.size = cv::Size(1024, 600);
+        return cc;
+    }
+
+    static IncrementalConfig incrementalConfig(const ReplayOptions& opt) {
+        IncrementalConfig ic;
+        ic.refreshFrames = opt.refreshFrames;
+        if (opt.fullResolution) ic.tilesAcross = 16;   // tiles as coarse on the capture frame as on the view
+        return ic;
+    }
+
+    ReplayOptions opt_;
+    ConditionConfig cc_;
+    FrameConditioner condition_;
+    cv::Mat raw_, scaled_;
+    ColorClassifier classifier_;
+    std::vector<BitMask> masks_;
+    BlobExtractor blobs_;
+    TiledDetector tiled_;
+    IncrementalDetector incremental_;
+    std::vector<cv::Rect> active_;
+    std::vector<cv::Rect> detections_;
+    std::vector<int> detectionClasses_;
+    TrackManager tracks_;
+    std::atomic<int> cycleRequests_{0};
+};
+
+// Mean ms per stage over the last ~second instead of a made-up ping: five
+// lines under the event log, refreshed every 30 frames.
+class TelemetryPanel {
+public:
+    void draw(HudCompositor& hud, const HudLayout& layout, cv::Scalar color) {
+        if (frames_++ % 30 == 0) update();
+        for (int i = 0; i < 5; i++)
+            hud.text(lines_[i], cv::Point(layout.leftX + 5, 170 + (6 + i) * 20), cv::FONT_HERSHEY_PLAIN, 0.9, color, 1);
+    }
+
+private:
+    void update() {
+        window_.update();
+        auto ms = [&](TelemetryStage s) { return window_.stage(s).meanMs; };
+        std::snprintf(lines_[0], sizeof(lines_[0]), "FPS %.0f DROP %llu", window_.rate(TelemetryCounter::FRAMES),
+                      (unsigned long long)(window_.counter(TelemetryCounter::CAPTURE_DROPPED) +
+                                           window_.counter(TelemetryCounter::DETECT_DROPPED)));
+        if (uint64_t tiles = window_.counter(TelemetryCounter::TILES)) {
+            size_t n = std::strlen(lines_[0]);
+            std::snprintf(lines_[0] + n, sizeof(lines_[0]) - n, " SKIP %.0f%%",
+                          100.0 * window_.counter(TelemetryCounter::TILES_SKIPPED) / tiles);
+        }
+        std::snprintf(lines_[1], sizeof(lines_[1]), "CAP %.1f CND %.1f", ms(TelemetryStage::CAPTURE), ms(TelemetryStage::CONDITION));
+        std::snprintf(lines_[2], sizeof(lines_[2]), "THR %.1f BLB %.1f", ms(TelemetryStage::THRESHOLD), ms(TelemetryStage::BLOBS));
+        std::snprintf(lines_[3], sizeof(lines_[3]), "TRK %.1f HUD %.1f", ms(TelemetryStage::TRACKING), ms(TelemetryStage::HUD));
+        std::snprintf(lines_[4], sizeof(lines_[4]), "SHW %.1f FRM %.1f", ms(TelemetryStage::IMSHOW), ms(TelemetryStage::FRAME));
+#ifndef ADS_TELEMETRY
+        std::snprintf(lines_[0], sizeof(lines_[0]), "TELEMETRY OFF");
+#endif
+    }
+
+    TelemetryWindow window_;
+    char lines_[5][32] = {};
+    int64_t frames_ = 0;
+};
@@ -0,0 +1,314 @@
+#pragma once
+
+// Retained-mode HUD. Widgets that never change are drawn once into a cached
+// BGRA layer; widgets that change every frame are drawn into a second BGRA
+// layer and only the rectangles they touched (dirty rects) are composited.
+// Text on the dynamic layer comes from a glyph atlas, so no Hershey
+// rasterization happens per frame once every character has been seen.
+
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// HH:MM:SS into a caller buffer, so the frame loop does not allocate
+inline void getCurrentTime(char* buf, size_t size) {
+    time_t now = time(0);
+    tm ltm;
+    localtime_r(&now, &ltm);
+    strftime(buf, size, "%H:%M:%S", &ltm);
+}
+
+inline void drawBracket(cv::Mat& img, int x, int y, int w, int h, cv::Scalar color) {
+    int len = w / 4;
+    cv::line(img, cv::Point(x, y), cv::Point(x + len, y), color, 2);
+    cv::line(img, cv::Point(x, y), cv::Point(x, y + len), color, 2);
+    cv::line(img, cv::Point(x + w, y), cv::Point(x + w - len, y), color, 2);
+    cv::line(img, cv::Point(x + w, y), cv::Point(x + w, y + len), color, 2);
+    cv::line(img, cv::Point(x, y + h), cv::Point(x + len, y + h), color, 2);
+    cv::line(img, cv::Point(x, y + h), cv::Point(x, y + h - len), color, 2);
+    cv::line(img, cv::Point(x + w, y + h), cv::Point(x + w - len, y + h), color, 2);
+    cv::line(img, cv::Point(x + w, y + h), cv::Point(x + w, y + h - len), color, 2);
+}
+
+// Hershey glyphs rasterized once per (font, scale, thickness, character) and
+// packed into a single 8-bit coverage texture.
+class GlyphAtlas {
+public:
+    struct Glyph {
+        cv::Rect rect;      // in the atlas
+        cv::Point offset;   // top-left relative to the text origin
+        double advance;     // pen advance in pixels
+    };
+
+    const Glyph& glyph(int font, double scale, int thickness, char c) {
+        uint64_t key = ((uint64_t)font << 48) | ((uint64_t)(scale * 1000) << 16) |
+                       ((uint64_t)thickness << 8) | (uint8_t)c;
+        auto it = glyphs_.find(key);
+        if (it != glyphs_.end()) return it->second;
+
+        std::string s(1, c);
+        int baseline = 0;
+        cv::Size size = cv::getTextSize(s, font, scale, thickness, &baseline);
+        int pad = thickness + 2;
+        cv::Size cell(size.width + 2 * pad, size.height + baseline + 2 * pad);
+
+        Glyph g;
+        g.rect = place(cell);
+        g.offset = cv::Point(-pad, -(pad + size.height));
+        // getTextSize rounds; measuring a run of 16 gives the fractional advance.
+        g.advance = (cv::getTextSize(std::string(16, c), font, scale, thickness, &baseline).width - thickness) / 16.0;
+        cv::Mat cellMat = atlas_(g.rect);
+        cellMat.setTo(cv::Scalar(0));
+        cv::putText(cellMat, s, cv::Point(pad, pad + size.height), font, scale, cv::Scalar(255), thickness);
+        return glyphs_.emplace(key, g).first->second;
+    }
+
+    // Rasterizes every printable ASCII character up front so later frames
+    // never miss (a miss allocates).
+    void preload(int font, double scale, int thickness) {
+        for (char c = 32; c < 127; c++) glyph(font, scale, thickness, c);
+    }
+
+    const cv::Mat& texture() const { return atlas_; }
+
+private:
+    // Shelf packing; the texture doubles in height when it runs out of room.
+    cv::Rect place(cv::Size cell) {
+        if (atlas_.empty()) atlas_ = cv::Mat::zeros(256, 512, CV_8UC1);
+        if (shelfX_ + cell.width > atlas_.cols) {
+            shelfY_ += shelfH_;
+            shelfX_ = shelfH_ = 0;
+        }
+        while (shelfY_ + cell.height > atlas_.rows) {
+            cv::Mat bigger = cv::Mat::zeros(atlas_.rows * 2, atlas_.cols, CV_8UC1);
+            atlas_.copyTo(bigger(cv::Rect(0, 0, atlas_.cols, atlas_.rows)));
+            atlas_ = bigger;
+        }
+        cv::Rect r(shelfX_, shelfY_, cell.width, cell.height);
+        shelfX_ += cell.width;
+        shelfH_ = std::max(shelfH_, cell.height);
+        return r;
+    }
+
+    cv::Mat atlas_;
+    int shelfX_ = 0, shelfY_ = 0, shelfH_ = 0;
+    std::unordered_map<uint64_t, Glyph> glyphs_;
+};
+
+// Fixed-capacity ring of preformatted lines; once full, each push overwrites
+// the oldest line. Nothing is allocated after construction.
+template <int Lines, int Width = 48>
+class LogRing {
+public:
+    __attribute__((format(printf, 2, 3)))
+    void push(const char* fmt, ...) {
+        va_list args;
+        va_start(args, fmt);
+        std::vsnprintf(lines_[(head_ + count_) % Lines], Width, fmt, args);
+        va_end(args);
+        if (count_ < Lines) count_++;
+        else head_ = (head_ + 1) % Lines;
+    }
+
+    int size() const { return count_; }
+    const char* operator[](int i) const { return lines_[(head_ + i) % Lines]; }   // 0 = oldest
+
+private:
+    char lines_[Lines][Width];
+    int head_ = 0, count_ = 0;
+};
+
+class HudCompositor {
+public:
+    explicit HudCompositor(cv::Size size)
+        : static_(cv::Mat::zeros(size, CV_8UC4)), dynamic_(cv::Mat::zeros(size, CV_8UC4)) {
+        dirty_.reserve(1024);
+    }
+
+    static cv::Scalar opaque(const cv::Scalar& c) { return cv::Scalar(c[0], c[1], c[2], 255); }
+
+    // Draws the static widgets. 'draw' gets the BGRA static layer and must
+    // use opaque() colours. Call again whenever the static content changes.
+    template <typename F>
+    void buildStatic(F draw) {
+        static_.setTo(cv::Scalar::all(0));
+        draw(static_);
+        spans_.clear();
+        for (int y = 0; y < static_.rows; y++) {
+            const cv::Vec4b* p = static_.ptr<cv::Vec4b>(y);
+            for (int x = 0; x < static_.cols;) {
+                if (!p[x][3]) { x++; continue; }
+                int x0 = x;
+                while (x < static_.cols && p[x][3]) x++;
+                spans_.push_back(Span{y, x0, x});
+            }
+        }
+    }
+
+    // Raw access to the dynamic layer for custom drawing inside 'dirty'.
+    cv::Mat& canvas(const cv::Rect& dirty) {
+        markDirty(dirty);
+        return dynamic_;
+    }
+
+    void line(cv::Point a, cv::Point b, const cv::Scalar& color, int thickness = 1) {
+        int pad = thickness + 1;
+        markDirty(cv::Rect(std::min(a.x, b.x) - pad, std::min(a.y, b.y) - pad,
+                           std::abs(a.x - b.x) + 2 * pad + 1, std::abs(a.y - b.y) + 2 * pad + 1));
+        cv::line(dynamic_, a, b, opaque(color), thickness);
+    }
+
+    void circle(cv::Point c, int radius, const cv::Scalar& color, int thickness = 1) {
+        int r = radius + std::max(thickness, 1) + 1;
+        markDirty(cv::Rect(c.x - r, c.y - r, 2 * r + 1, 2 * r + 1));
+        cv::circle(dynamic_, c, radius, opaque(color), thickness);
+    }
+
+    // Outlines mark only their four edges dirty, filled rects the whole area.
+    void rectangle(cv::Point a, cv::Point b, const cv::Scalar& color, int thickness = 1) {
+        cv::Rect box(a, b);
+        if (thickness < 0) {
+            markDirty(cv::Rect(box.x, box.y, box.width + 1, box.height + 1));
+        } else {
+            int pad = thickness + 1, edge = 2 * pad + 1;
+            markDirty(cv::Rect(box.x - pad, box.y - pad, box.width + edge, edge));
+            markDirty(cv::Rect(box.x - pad, box.y + box.height - pad, box.width + edge, edge));
+            markDirty(cv::Rect(box.x - pad, box.y - pad, edge, box.height + edge));
+            markDirty(cv::Rect(box.x + box.width - pad, box.y - pad, edge, box.height + edge));
+        }
+        cv::rectangle(dynamic_, a, b, opaque(color), thickness);
+    }
+
+    void bracket(int x, int y, int w, int h, const cv::Scalar& color) {
+        markDirty(cv::Rect(x - 2, y - 2, w + 5, h + 5));
+        drawBracket(dynamic_, x, y, w, h, opaque(color));
+    }
+
+    void preloadFont(int font, double scale, int thickness = 1) { atlas_.preload(font, scale, thickness); }
+
+    // putText through the glyph atlas.
+    void text(const char* s, cv::Point org, int font, double scale, const cv::Scalar& color, int thickness = 1) {
+        cv::Vec4b c((uchar)color[0], (uchar)color[1], (uchar)color[2], 255);
+        double pen = org.x;
+        for (; *s; s++) {
+            const GlyphAtlas::Glyph& g = atlas_.glyph(font, scale, thickness, *s);
+            const cv::Mat& tex = atlas_.texture();
+            cv::Rect dst(cvRound(pen) + g.offset.x, org.y + g.offset.y, g.rect.width, g.rect.height);
+            cv::Rect clipped = dst & cv::Rect(0, 0, dynamic_.cols, dynamic_.rows);
+            pen += g.advance;
+            if (clipped.empty()) continue;
+            markDirty(clipped);
+            for (int y = clipped.y; y < clipped.y + clipped.height; y++) {
+                const uchar* m = tex.ptr<uchar>(g.rect.y + y - dst.y) + g.rect.x - dst.x;
+                cv::Vec4b* d = dynamic_.ptr<cv::Vec4b>(y);
+                for (int x = clipped.x; x < clipped.x + clipped.width; x++)
+                    if (m[x]) d[x] = c;
+            }
+        }
+    }
+
+    void text(const std::string& s, cv::Point org, int font, double scale, const cv::Scalar& color, int thickness = 1) {
+        text(s.c_str(), org, font, scale, color, thickness);
+    }
+
+    // Single pass over the cached static spans and this frame's dirty rects,
+    // writing onto 'frame' (BGR, same size). The dynamic layer is cleared
+    // behind the pass, ready for the next frame.
+    void compose(cv::Mat& frame) {
+        CV_Assert(frame.type() == CV_8UC3 && frame.rows == static_.rows && frame.cols == static_.cols);
+        for (const Span& s : spans_) {
+            const cv::Vec4b* src = static_.ptr<cv::Vec4b>(s.y);
+            cv::Vec3b* dst = frame.ptr<cv::Vec3b>(s.y);
+            for (int x = s.x0; x < s.x1; x++) dst[x] = cv::Vec3b(src[x][0], src[x][1], src[x][2]);
+        }
+        for (const cv::Rect& r : dirty_) {
+            for (int y = r.y; y < r.y + r.height; y++) {
+                cv::Vec4b* src = dynamic_.ptr<cv::Vec4b>(y);
+                cv::Vec3b* dst = frame.ptr<cv::Vec3b>(y);
+                for (int x = r.x; x < r.x + r.width; x++) {
+                    if (!src[x][3]) continue;
+                    dst[x] = cv::Vec3b(src[x][0], src[x][1], src[x][2]);
+                    src[x] = cv::Vec4b(0, 0, 0, 0);
+                }
+            }
+        }
+        dirty_.clear();
+    }
+
+private:
+    struct Span {
+        int y, x0, x1;
+    };
+
+    void markDirty(cv::Rect r) {
+        r &= cv::Rect(0, 0, dynamic_.cols, dynamic_.rows);
+        if (!r.empty()) dirty_.push_back(r);
+    }
+
+    cv::Mat static_, dynamic_;
+    std::vector<Span> spans_;
+    std::vector<cv::Rect> dirty_;
+    GlyphAtlas atlas_;
+};
+
+// Panel positions of the targeting HUD for a screen size.
+struct HudLayout {
+    explicit HudLayout(cv::Size s)
+        : size(s), leftX(20), rightX(s.width - 180), botY(s.height - 60), radX(100), radY(s.height - 100),
+          center(s.width / 2, s.height / 2) {}
+
+    cv::Size size;
+    int leftX, rightX;      // left data column, right data column
+    int botY;               // top of the weapon boxes
+    int radX, radY;         // radar centre
+    cv::Point center;
+};
+
+// Static widgets every HUD variant has: position and weather data, the
+// system log frame, the altitude tape, the top bar, the weapon labels, the
+// radar ring and the centre cross. Meant for HudCompositor::buildStatic.
+inline void drawStaticHud(cv::Mat& layer, const HudLayout& l, cv::Scalar cyan, cv::Scalar white, cv::Scalar red) {
+    cv::Scalar c = HudCompositor::opaque(cyan), w = HudCompositor::opaque(white), r = HudCompositor::opaque(red);
+
+    // --- LEFT SIDE DATA ---
+    cv::putText(layer, "UNIT: 777-AGR", cv::Point(l.leftX, 40), cv::FONT_HERSHEY_SIMPLEX, 0.6, c, 1);
+    cv::putText(layer, "SEC: CAIRO_N", cv::Point(l.leftX, 65), cv::FONT_HERSHEY_SIMPLEX, 0.6, c, 1);
+    cv::putText(layer, "LAT: 30.0444 N", cv::Point(l.leftX, 90), cv::FONT_HERSHEY_SIMPLEX, 0.5, w, 1);
+    cv::putText(layer, "LON: 31.2357 E", cv::Point(l.leftX, 110), cv::FONT_HERSHEY_SIMPLEX, 0.5, w, 1);
+
+    cv::rectangle(layer, cv::Point(l.leftX, 130), cv::Point(l.leftX + 150, 400), c, 1);
+    cv::putText(layer, "SYSTEM LOG", cv::Point(l.leftX + 5, 145), cv::FONT_HERSHEY_PLAIN, 1, c, 1);
+
+    // --- RIGHT SIDE DATA ---
+    cv::putText(layer, "WIND: 12 KTS", cv::Point(l.rightX, 40), cv::FONT_HERSHEY_PLAIN, 1, c, 1);
+    cv::putText(layer, "VIS: 10 KM", cv::Point(l.rightX, 60), cv::FONT_HERSHEY_PLAIN, 1, c, 1);
+    cv::putText(layer, "TEMP: 34 C", cv::Point(l.rightX, 80), cv::FONT_HERSHEY_PLAIN, 1, c, 1);
+
+    // Altitude Tape
+    cv::line(layer, cv::Point(l.rightX - 20, 100), cv::Point(l.rightX - 20, 400), c, 2);
+    for (int i = 0; i < 10; i++) {
+        cv::line(layer, cv::Point(l.rightX - 20, 120 + i * 30), cv::Point(l.rightX - 10, 120 + i * 30), c, 1);
+        cv::putText(layer, std::to_string(1000 - i * 100), cv::Point(l.rightX, 125 + i * 30), cv::FONT_HERSHEY_PLAIN, 0.8, w, 1);
+    }
+
+    // --- TOP BAR ---
+    cv::rectangle(layer, cv::Point(300, 10), cv::Point(724, 50), HudCompositor::opaque(cv::Scalar(0, 50, 0)), cv::FILLED);
+    cv::line(layer, cv::Point(512, 10), cv::Point(512, 60), r, 2);
+
+    // --- BOTTOM BAR (WEAPONS) ---
+    for (int i = 0; i < 4; i++)
+        cv::putText(layer, "M-" + std::to_string(i + 1), cv::Point(310 + i * 110, l.botY + 25), cv::FONT_HERSHEY_PLAIN, 1, w, 1);
+
+    // --- RADAR CIRCLE ---
+    cv::circle(layer, cv::Point(l.radX, l.radY), 70, HudCompositor::opaque(cv::Scalar(0, 100, 0)), 1);
+
+    // --- CENTER HUD ---
+    cv::line(layer, cv::Point(l.center.x - 20, l.center.y), cv::Point(l.center.x + 20, l.center.y), c, 1);
+    cv::line(layer, cv::Point(l.center.x, l.center.y - 20), cv::Point(l.center.x, l.center.y + 20), c, 1);
+}
@@ -0,0 +1,199 @@
+#include <opencv2/opencv.hpp>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include "journal.hpp"
+#include "hud.hpp"
+
+using namespace cv;
+using namespace std;
+
+// After-action review of a session journal written by 1 / 2 --journal.
+//
+// journal <file> [--info] [--events] [--at <record> | --time <s>] [--view]
+//   --info      header, time span, records kept and dropped (the default)
+//   --events    every engagement event with its time
+//   --at        HUD state at a record number, --time at seconds into the session
+//   --view      step through the session in a window: a/d one frame, w/s one
+//               second, q/e one minute, space plays, ESC quits
+
+static const char* stateName(int s) {
+    static const char* names[] = {"TENTATIVE", "CONFIRMED", "COASTING", "DELETED"};
+    return s >= 0 && s < 4 ? names[s] : "?";
+}
+
+// Same wording as the live event log in 1.cpp.
+static void eventText(const JournalEvent& e, char* buf, size_t size) {
+    switch (e.type) {
+    case EngageEvent::LAUNCH: snprintf(buf, size, "M-%d LAUNCH > T%d", e.launcher + 1, e.target); break;
+    case EngageEvent::HIT: snprintf(buf, size, "TARGET HIT!! T%d", e.target); break;
+    case EngageEvent::MISS: snprintf(buf, size, "M-%d MISSED T%d", e.launcher + 1, e.target); break;
+    case EngageEvent::LOST: snprintf(buf, size, "MISSILE LOST"); break;
+    case EngageEvent::RELOADED: snprintf(buf, size, "M-%d RELOADED", e.launcher + 1); break;
+    default: snprintf(buf, size, "EVENT %d", e.type);
+    }
+}
+
+static double secondsAt(const JournalReader& j, const JournalRecord& r) {
+    return (r.timeNs - j.header().startNs) / 1e9;
+}
+
+static void printInfo(const JournalReader& j) {
+    const JournalHeader& h = j.header();
+    cout << "records " << j.end() << " written, " << j.end() - j.first() << " kept (ring of " << h.capacity
+         << "), " << h.dropped << " dropped" << endl;
+    if (h.seed) cout << "engagement seed " << h.seed << endl;
+    else cout << "no engagement" << endl;
+    if (!j.empty())
+        cout << "span +" << secondsAt(j, j.at(j.first())) << " s .. +" << secondsAt(j, j.at(j.end() - 1)) << " s" << endl;
+    for (int c = 1; c <= JournalHeader::MAX_CLASSES; c++)
+        if (*j.className(c)) cout << "class " << c << " " << j.className(c) << endl;
+}
+
+static void printEvents(const JournalReader& j) {
+    char text[64];
+    for (uint64_t n = j.first(); n < j.end(); n++) {
+        const JournalRecord& r = j.at(n);
+        for (int i = 0; i < r.eventCount; i++) {
+            eventText(r.events[i], text, sizeof(text));
+            printf("%8llu  +%9.3f  %s\n", (unsigned long long)n, secondsAt(j, r), text);
+        }
+    }
+}
+
+static void printState(const JournalReader& j, uint64_t n) {
+    const JournalRecord& r = j.at(n);
+    printf("record %llu  +%.3f s  engaged %s", (unsigned long long)n, secondsAt(j, r), r.engaged < 0 ? "none" : "");
+    if (r.engaged >= 0) printf("T%d", r.engaged);
+    printf("\n");
+    for (int i = 0; i < r.trackCount; i++) {
+        const JournalTrack& t = r.tracks[i];
+        printf("  T%-4d %-9s %-8s box %d,%d %dx%d  hits %d\n", t.id, stateName(t.state), j.className(t.cls),
+               t.x, t.y, t.w, t.h, t.hits);
+    }
+    if (r.launcherCount) {
+        printf("  rounds");
+        for (int l = 0; l < r.launcherCount; l++) printf(" %d", r.rounds[l]);
+        printf("\n");
+    }
+    printf("  interceptors %d%s\n", r.interceptorCount, r.truncated ? "  (record truncated)" : "");
+    char text[64];
+    printf("  log\n");
+    j.recentEvents(n, 6, [&](const JournalRecord& er, const JournalEvent& e) {
+        eventText(e, text, sizeof(text));
+        printf("    +%.3f %s\n", secondsAt(j, er), text);
+    });
+}
+
+// HUD state of record n on a blank display, laid out like 1.cpp.
+static void drawState(const JournalReader& j, uint64_t n, const HudLayout& layout, Mat& display) {
+    Scalar cyan(255, 255, 0), red(0, 0, 255), green(0, 255, 0), white(200, 200, 200), yellow(0, 255, 255);
+    const JournalRecord& r = j.at(n);
+    display.setTo(Scalar(0, 0, 0));
+    drawStaticHud(display, layout, cyan, white, red);
+    char text[64];
+
+    // event log, oldest at the top
+    const JournalEvent* events[6];
+    int count = 0;
+    j.recentEvents(n, 6, [&](const JournalRecord&, const JournalEvent& e) { events[count++] = &e; });
+    for (int i = 0; i < count; i++) {
+        eventText(*events[count - 1 - i], text, sizeof(text));
+        putText(display, text, Point(layout.leftX + 5, 170 + i * 20), FONT_HERSHEY_PLAIN, 0.9, white, 1);
+    }
+
+    for (int i = 0; i < r.trackCount; i++) {
+        const JournalTrack& t = r.tracks[i];
+        if (t.state != (int)TrackState::CONFIRMED && t.state != (int)TrackState::COASTING) continue;
+        bool engaged = t.id == r.engaged;
+        Scalar color = engaged ? red : white;
+        drawBracket(display, t.x - 10, t.y - 10, t.w + 20, t.h + 20, color);
+        snprintf(text, sizeof(text), engaged ? "LOCK T%d %s" : "T%d %s", t.id, j.className(t.cls));
+        putText(display, text, Point(t.x, t.y - 20), FONT_HERSHEY_PLAIN, 1, color, 1);
+    }
+    for (int l = 0; l < r.launcherCount; l++) {
+        bool empty = r.rounds[l] == 0;
+        rectangle(display, Point(300 + l * 110, layout.botY), Point(400 + l * 110, layout.botY + 40), empty ? red : cyan, 1);
+        putText(display, empty ? "EMPTY" : "RDY", Point(360 + l * 110, layout.botY + 25), FONT_HERSHEY_PLAIN, 1,
+                empty ? red : green, 1);
+    }
+    for (int i = 0; i < r.interceptorCount; i++)
+        circle(display, Point(r.interceptors[i][0], r.interceptors[i][1]), 5, yellow, FILLED);
+
+    snprintf(text, sizeof(text), "REC %llu  +%.2f S", (unsigned long long)n, secondsAt(j, r));
+    putText(display, text, Point(display.cols / 2 - 80, 80), FONT_HERSHEY_SIMPLEX, 0.6, cyan, 1);
+}
+
+static void view(const JournalReader& j, uint64_t n) {
+    HudLayout layout(Size(1024, 600));
+    Mat display(layout.size, CV_8UC3);
+    namedWindow("ADS journal", WINDOW_NORMAL);
+    bool playing = false;
+    while (true) {
+        drawState(j, n, layout, display);
+        imshow("ADS journal", display);
+        // while playing, wait as long as the session did between the two frames
+        int delay = 0;
+        if (playing && n + 1 < j.end())
+            delay = (int)std::min<int64_t>(200, std::max<int64_t>(1, (j.at(n + 1).timeNs - j.at(n).timeNs) / 1000000));
+        int key = waitKey(delay);
+        // about 30 records per second of session
+        int64_t step = 0;
+        if (key == 27) break;
+        else if (key == ' ') playing = !playing;
+        else if (key == 'd') step = 1;
+        else if (key == 'a') step = -1;
+        else if (key == 'w') step = 30;
+        else if (key == 's') step = -30;
+        else if (key == 'e') step = 1800;
+        else if (key == 'q') step = -1800;
+        else if (key < 0 && playing) step = 1;
+        int64_t next = (int64_t)n + step;
+        n = (uint64_t)std::max<int64_t>((int64_t)j.first(), std::min<int64_t>((int64_t)j.end() - 1, next));
+        if (n + 1 == j.end()) playing = false;
+    }
+    destroyAllWindows();
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        cerr << "usage: journal <file> [--info] [--events] [--at <record> | --time <s>] [--view]" << endl;
+        return -1;
+    }
+    JournalReader j;
+    if (!j.open(argv[1])) {
+        cerr << "Error: " << argv[1] << " is not a readable journal" << endl;
+        return -1;
+    }
+    bool info = false, events = false, state = false, show = false;
+    uint64_t n = j.first();
+    for (int i = 2; i < argc; i++) {
+        string a = argv[i];
+        bool more = i + 1 < argc;
+        if (a == "--info") info = true;
+        else if (a == "--events") events = true;
+        else if (a == "--at" && more) {
+            n = std::stoull(argv[++i]);
+            state = true;
+        } else if (a == "--time" && more) {
+            n = j.seekTime(j.header().startNs + (int64_t)(std::stod(argv[++i]) * 1e9));
+            state = true;
+        } else if (a == "--view") show = true;
+        else {
+            cerr << "Unknown argument " << a << endl;
+            return -1;
+        }
+    }
+    if (!info && !events && !state && !show) info = true;
+
+    if (info) printInfo(j);
+    if (j.empty()) return 0;
+    if (n < j.first() || n >= j.end()) {
+        cerr << "Record " << n << " is not in the journal (" << j.first() << " .. " << j.end() - 1 << ")" << endl;
+        return -1;
+    }
+    if (events) printEvents(j);
+    if (state) printState(j, n);
+    if (show) view(j, n);
+    return 0;
+}
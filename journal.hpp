@@ -0,0 +1,365 @@
+#pragma once
+
+// Binary session journal. Every rendered frame appends one fixed-size record
+// (time, tracks, engaged track, launcher rounds, interceptors and the
+// engagement events of that frame) to a ring of records in a memory-mapped
+// file. The render loop only copies its record into an in-memory queue;
+// a background thread moves queued records into the mapping, so the loop
+// never waits on I/O. Fixed-size records make seeking to frame n a
+// multiplication, and each record links back to the last one with events, so
+// the event log at any frame is rebuilt without scanning the session.
+
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "engage.hpp"
+#include "tracks.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define ADS_JOURNAL_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+struct JournalTrack {
+    int32_t id;
+    int16_t x, y, w, h;
+    uint8_t state;      // TrackState
+    uint8_t cls;        // colour class ID
+    uint16_t hits;
+};
+
+struct JournalEvent {
+    uint8_t type;       // EngageEvent::Type
+    int8_t launcher;
+    uint16_t reserved;
+    int32_t target;
+    int16_t x, y;
+};
+
+struct JournalRecord {
+    enum { MAX_TRACKS = 32, MAX_EVENTS = 8, MAX_INTERCEPTORS = 16, MAX_LAUNCHERS = 8 };
+    enum { TRACKS_CUT = 1, EVENTS_CUT = 2, INTERCEPTORS_CUT = 4 };   // 'truncated' bits
+
+    uint64_t frame;             // record number, set by the writer
+    int64_t timeNs;             // wall clock, ns since the epoch
+    uint64_t lastEvents;        // newest record up to this one with events, UINT64_MAX if none
+    int32_t engaged;            // engaged track ID, -1 for none
+    uint8_t trackCount, eventCount, interceptorCount, launcherCount;
+    uint8_t rounds[MAX_LAUNCHERS];
+    uint8_t truncated;
+    uint8_t reserved[7];
+    JournalTrack tracks[MAX_TRACKS];
+    JournalEvent events[MAX_EVENTS];
+    int16_t interceptors[MAX_INTERCEPTORS][2];
+
+    // Empty record stamped with the current time.
+    void clear() {
+        std::memset(this, 0, sizeof(*this));
+        engaged = -1;
+        timeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    void addTrack(const Track& t) {
+        if (trackCount == MAX_TRACKS) {
+            truncated |= TRACKS_CUT;
+            return;
+        }
+        JournalTrack& j = tracks[trackCount++];
+        j.id = t.id;
+        j.x = clamp16(t.box.x);
+        j.y = clamp16(t.box.y);
+        j.w = clamp16(t.box.width);
+        j.h = clamp16(t.box.height);
+        j.state = (uint8_t)t.state;
+        j.cls = (uint8_t)t.cls;
+        j.hits = (uint16_t)std::min(t.hits, 65535);
+    }
+
+    void addEvent(const EngageEvent& e) {
+        if (eventCount == MAX_EVENTS) {
+            truncated |= EVENTS_CUT;
+            return;
+        }
+        JournalEvent& j = events[eventCount++];
+        j.type = (uint8_t)e.type;
+        j.launcher = (int8_t)e.launcher;
+        j.target = e.target;
+        j.x = clamp16(cvRound(e.pos.x));
+        j.y = clamp16(cvRound(e.pos.y));
+    }
+
+    // Launcher rounds and interceptor positions.
+    void addEngine(const EngagementEngine& engine) {
+        launcherCount = (uint8_t)std::min<int>(engine.launcherCount(), MAX_LAUNCHERS);
+        for (int l = 0; l < launcherCount; l++) rounds[l] = (uint8_t)std::min(engine.rounds(l), 255);
+        const InterceptorArrays& in = engine.interceptors();
+        if (in.size() > MAX_INTERCEPTORS) truncated |= INTERCEPTORS_CUT;
+        interceptorCount = (uint8_t)std::min<int>(in.size(), MAX_INTERCEPTORS);
+        for (int i = 0; i < interceptorCount; i++) {
+            interceptors[i][0] = clamp16(cvRound(in.x[i]));
+            interceptors[i][1] = clamp16(cvRound(in.y[i]));
+        }
+    }
+
+    // The whole record of one frame: every track and the engaged one's ID,
+    // plus, for a program that flies interceptors, the engine's events since
+    // its last clearEvents() and its launcher / interceptor state.
+    void fill(const std::vector<Track>& trackList, int engagedId, const EngagementEngine* engine = nullptr) {
+        clear();
+        for (const Track& t : trackList) addTrack(t);
+        engaged = engagedId;
+        if (!engine) return;
+        for (const EngageEvent& e : engine->events()) addEvent(e);
+        addEngine(*engine);
+    }
+
+    static int16_t clamp16(int v) { return (int16_t)std::max(-32768, std::min(32767, v)); }
+};
+
+static_assert(sizeof(JournalRecord) % 8 == 0, "records are kept 8-byte aligned in the file");
+
+// First page of the file.
+struct JournalHeader {
+    enum { MAX_CLASSES = 16, PAGE = 4096 };
+    char magic[8];              // "ADSJRNL"
+    uint32_t version;
+    uint32_t recordSize;
+    uint64_t capacity;          // records in the ring
+    uint64_t written;           // records appended; the ring holds the last min(written, capacity)
+    uint64_t dropped;           // records lost because the queue was full
+    uint64_t seed;              // engagement seed of the session, 0 without engagement
+    int64_t startNs;
+    char classNames[MAX_CLASSES][16];   // names of class IDs 1.., for the review tool
+};
+
+static_assert(sizeof(JournalHeader) <= JournalHeader::PAGE, "header fits the first page");
+
+class JournalWriter {
+public:
+    JournalWriter() {}
+    ~JournalWriter() { close(); }
+
+    // 'capacity' records; 108000 is an hour at 30 fps, about 78 MB.
+    bool open(const std::string& path, uint64_t capacity, uint64_t seed,
+              const std::vector<std::string>& classNames = std::vector<std::string>()) {
+        close();
+        if (capacity == 0) return false;
+#ifdef ADS_JOURNAL_MMAP
+        bytes_ = JournalHeader::PAGE + capacity * sizeof(JournalRecord);
+        fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd_ < 0 || ftruncate(fd_, (off_t)bytes_) != 0) {
+            std::cerr << "Warning: could not create journal " << path << std::endl;
+            close();
+            return false;
+        }
+        void* p = mmap(nullptr, bytes_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+        if (p == MAP_FAILED) {
+            std::cerr << "Warning: could not map journal " << path << std::endl;
+            close();
+            return false;
+        }
+        base_ = (char*)p;
+        JournalHeader* h = header();
+        std::memcpy(h->magic, "ADSJRNL", 8);
+        h->version = 1;
+        h->recordSize = sizeof(JournalRecord);
+        h->capacity = capacity;
+        h->seed = seed;
+        h->startNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        for (size_t i = 0; i < classNames.size() && i < JournalHeader::MAX_CLASSES; i++)
+            std::strncpy(h->classNames[i], classNames[i].c_str(), sizeof(h->classNames[i]) - 1);
+        capacity_ = capacity;
+        lastEvents_ = UINT64_MAX;
+        queue_.resize(QUEUE);
+        head_ = tail_ = dropped_ = 0;
+        running_ = true;
+        thread_ = std::thread([this] { run(); });
+        return true;
+#else
+        (void)path; (void)capacity; (void)seed; (void)classNames;
+        std::cerr << "Warning: the journal needs mmap, not available on this platform" << std::endl;
+        return false;
+#endif
+    }
+
+    bool isOpen() const { return base_ != nullptr; }
+
+    // Render loop side: queues a copy of the record. Never blocks; returns
+    // false (and counts a drop) when the writer thread has fallen behind.
+    bool append(const JournalRecord& r) {
+        if (!base_) return false;
+        uint64_t t = tail_.load(std::memory_order_relaxed);
+        if (t - head_.load(std::memory_order_acquire) == QUEUE) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        queue_[t % QUEUE] = r;
+        tail_.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Flushes what is queued, syncs the file and unmaps it.
+    void close() {
+        running_ = false;
+        if (thread_.joinable()) thread_.join();
+#ifdef ADS_JOURNAL_MMAP
+        if (base_) {
+            drain();
+            msync(base_, bytes_, MS_SYNC);
+            munmap(base_, bytes_);
+        }
+        if (fd_ >= 0) ::close(fd_);
+#endif
+        base_ = nullptr;
+        fd_ = -1;
+    }
+
+private:
+    enum { QUEUE = 256 };   // ~8 s of frames at 30 fps
+
+    JournalHeader* header() { return (JournalHeader*)base_; }
+
+    void run() {
+        auto lastSync = std::chrono::steady_clock::now();
+        while (running_) {
+            if (!drain()) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+#ifdef ADS_JOURNAL_MMAP
+            auto now = std::chrono::steady_clock::now();
+            if (now - lastSync > std::chrono::seconds(1)) {
+                msync(base_, bytes_, MS_ASYNC);
+                lastSync = now;
+            }
+#endif
+        }
+    }
+
+    // Moves queued records into the ring; false when there were none.
+    bool drain() {
+        uint64_t h = head_.load(std::memory_order_relaxed), t = tail_.load(std::memory_order_acquire);
+        if (h == t) return false;
+        JournalHeader* hd = header();
+        JournalRecord* ring = (JournalRecord*)(base_ + JournalHeader::PAGE);
+        for (; h != t; h++) {
+            uint64_t n = hd->written;
+            JournalRecord& r = ring[n % capacity_];
+            r = queue_[h % QUEUE];
+            r.frame = n;
+            if (r.eventCount) lastEvents_ = n;
+            r.lastEvents = lastEvents_;
+            hd->written = n + 1;
+        }
+        hd->dropped = dropped_.load(std::memory_order_relaxed);
+        head_.store(h, std::memory_order_release);
+        return true;
+    }
+
+    char* base_ = nullptr;
+    int fd_ = -1;
+    size_t bytes_ = 0;
+    uint64_t capacity_ = 0, lastEvents_ = UINT64_MAX;
+    std::vector<JournalRecord> queue_;
+    std::atomic<uint64_t> head_{0}, tail_{0}, dropped_{0};
+    std::atomic<bool> running_{false};
+    std::thread thread_;
+};
+
+// Read side for the review tool: maps a journal read-only. Record numbers
+// run over [first(), end()); older ones have been overwritten by the ring.
+class JournalReader {
+public:
+    ~JournalReader() { close(); }
+
+    bool open(const std::string& path) {
+        close();
+#ifdef ADS_JOURNAL_MMAP
+        fd_ = ::open(path.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd_ < 0 || fstat(fd_, &st) != 0 || (size_t)st.st_size < JournalHeader::PAGE) {
+            close();
+            return false;
+        }
+        bytes_ = (size_t)st.st_size;
+        void* p = mmap(nullptr, bytes_, PROT_READ, MAP_SHARED, fd_, 0);
+        if (p == MAP_FAILED) {
+            close();
+            return false;
+        }
+        base_ = (const char*)p;
+        const JournalHeader& h = header();
+        if (std::memcmp(h.magic, "ADSJRNL", 8) != 0 || h.version != 1 || h.recordSize != sizeof(JournalRecord) ||
+            bytes_ < JournalHeader::PAGE + h.capacity * sizeof(JournalRecord)) {
+            close();
+            return false;
+        }
+        return true;
+#else
+        (void)path;
+        return false;
+#endif
+    }
+
+    void close() {
+#ifdef ADS_JOURNAL_MMAP
+        if (base_) munmap((void*)base_, bytes_);
+        if (fd_ >= 0) ::close(fd_);
+#endif
+        base_ = nullptr;
+        fd_ = -1;
+    }
+
+    const JournalHeader& header() const { return *(const JournalHeader*)base_; }
+
+    uint64_t end() const { return header().written; }
+    uint64_t first() const { return end() > header().capacity ? end() - header().capacity : 0; }
+    bool empty() const { return first() == end(); }
+
+    const JournalRecord& at(uint64_t n) const {
+        return ((const JournalRecord*)(base_ + JournalHeader::PAGE))[n % header().capacity];
+    }
+
+    // First record at or after 'ns' (wall clock), by binary search.
+    uint64_t seekTime(int64_t ns) const {
+        uint64_t lo = first(), hi = end();
+        while (lo < hi) {
+            uint64_t mid = lo + (hi - lo) / 2;
+            if (at(mid).timeNs < ns) lo = mid + 1;
+            else hi = mid;
+        }
+        return std::min(lo, end() ? end() - 1 : 0);
+    }
+
+    // Up to 'max' most recent events at or before record n, newest first,
+    // following the lastEvents links.
+    template <typename F>
+    void recentEvents(uint64_t n, int max, F f) const {
+        uint64_t k = at(n).lastEvents;
+        while (max > 0 && k != UINT64_MAX && k >= first() && k <= n) {
+            const JournalRecord& r = at(k);
+            for (int i = r.eventCount - 1; i >= 0 && max > 0; i--, max--) f(r, r.events[i]);
+            if (k == first()) break;
+            k = at(k - 1).lastEvents;
+        }
+    }
+
+    const char* className(int cls) const {
+        return cls >= 1 && cls <= JournalHeader::MAX_CLASSES && header().classNames[cls - 1][0]
+            ? header().classNames[cls - 1] : "";
+    }
+
+private:
+    const char* base_ = nullptr;
+    int fd_ = -1;
+    size_t bytes_ = 0;
+};
@@ -1,14 +1,46 @@
 #include <opencv2/opencv.hpp>
 #include <iostream>
+#include <memory>
 #include <string>
+#include "replay.hpp"
+#include "threshold.hpp"
+#include "detect.hpp"
+#include "tracker.hpp"
+#include "pipeline.hpp"
+#include "telemetry.hpp"
+#include "yuv.hpp"
+#include "camera.hpp"
 
 using namespace cv;
 using namespace std;
 
-int main() {
-    VideoCapture cap(0);
+struct Detected {
+    Mat frame;
+    int64_t seq = 0, captureTick = 0;
+    bool locked = false, coasting = false;
+    Rect box;
+};
+
+int main(int argc, char** argv) {
+    ReplayOptions opt = parseReplayArgs(argc, argv);
+    if (opt.headless) {
+        DetectorConfig cfg;
+        cfg.minArea = 500;
+        cfg.morphology = true;
+        cfg.condition.shade = false;
+        return runReplay(opt, cfg);
+    }
 
-    if (!cap.isOpened()) {
+    // --yuv: detection on the camera's own YUV buffers, BGR only for display
+    unique_ptr<YuvCamera> yuvCam;
+    VideoCapture cap;
+    if (!opt.yuvSource.empty()) {
+        yuvCam = openYuvCamera(opt.yuvSource, opt.yuvSize, opt.yuvFormat, opt.yuvFps);
+        if (!yuvCam->isOpened()) {
+            cout << "Error: " << yuvCam->error() << endl;
+            return -1;
+        }
+    } else if (!cap.open(0)) {
         cout << "Error: Could not open webcam." << endl;
         return -1;
     }
@@ -17,63 +49,110 @@ int main() {
     Scalar lowerColor(100, 150, 0); 
     Scalar upperColor(140, 255, 255);
 
-    Mat frame, hsv, mask;
+    BitMask mask, opened;
+    BitMorphology morph;
+    BlobExtractor blobs;
+    RoiTracker tracker;
+
+    FramePipeline<Detected> pipeline(
+        [&](FramePacket& p) {
+            if (yuvCam) {
+                // Detection is done with the frame this slot held last time
+                yuvCam->release(p.buffer);
+                ADS_TIME_STAGE(CAPTURE);
+                return yuvCam->read(p.frame, p.buffer);
+            }
+            {
+                ADS_TIME_STAGE(CAPTURE);
+                cap >> p.frame;
+            }
+            if (p.frame.empty()) return false;
+            ADS_TIME_STAGE(CONDITION);
+            flip(p.frame, p.frame, 1);
+            return true;
+        },
+        [&](FramePacket& in, Detected& out) {
+            ADS_LAPS(laps);
+            // The YUV mask is on the 2x2 chroma grid: window, area and box scale by 2
+            Size size = yuvCam ? yuvFrameSize(in.frame, yuvCam->format()) : in.frame.size();
+            Rect window = tracker.searchWindow(size);
+            if (yuvCam) {
+                window = toChroma(window, yuvChromaSize(in.frame, yuvCam->format()));
+                yuvToMask(in.frame, yuvCam->format(), window, lowerColor, upperColor, mask);
+            } else {
+                bgrToMask(in.frame(window), lowerColor, upperColor, mask);
+            }
+            ADS_LAP(laps, THRESHOLD);
+
+            // erode + dilate with the 5x5 ellipse, on the packed mask
+            morph.openEllipse5(mask, opened);
+            ADS_LAP(laps, MORPHOLOGY);
+
+            Rect found;
+            bool hit = largestBlob(opened, window.tl(), yuvCam ? 500 / 4.0 : 500, found, blobs);
+            if (yuvCam) found = fromChroma(found);
+            ADS_LAP(laps, BLOBS);
+            tracker.update(hit, found);
+            ADS_LAP(laps, TRACKING);
+            out.locked = tracker.locked();
+            out.coasting = tracker.coasting();
+            out.box = tracker.box();
+            if (!yuvCam) {
+                swap(in.frame, out.frame);
+                return;
+            }
+            // BGR for display only, mirrored like the webcam path; the raw
+            // buffer goes back to the camera when the capture slot is reused
+            cvtColor(in.frame, out.frame, yuvToBgrCode(yuvCam->format()));
+            flip(out.frame, out.frame, 1);
+            out.box.x = size.width - out.box.x - out.box.width;
+            ADS_LAP(laps, CONDITION);
+        });
+    TelemetryWriter telemetryLog(opt.telemetryPath);
+    pipeline.start();
 
     while (true) {
+        Detected* d = pipeline.next(chrono::milliseconds(100));
+        if (!d) {
+            if (pipeline.finished() || pollKey() == 27) break;
+            continue;
+        }
+        ADS_TIME_STAGE(FRAME);
+        ADS_LAPS(frameLaps);
+        ADS_COUNT(FRAMES, 1);
+        Mat& frame = d->frame;
 
-cap >> frame;
-        if (frame.empty()) break;
-
-        flip(frame, frame, 1);
-
-        cvtColor(frame, hsv, COLOR_BGR2HSV);
-
-        inRange(hsv, lowerColor, upperColor, mask);
-
-        erode(mask, mask, getStructuringElement(MORPH_ELLIPSE, Size(5, 5)));
-        dilate(mask, mask, getStructuringElement(MORPH_ELLIPSE, Size(5, 5)));
-
-        vector<vector<Point>> contours;
-        findContours(mask, contours, RETR_EXTERNAL, CHAIN_APPROX_SIMPLE);
-
-        if (!contours.empty()) {
-            double maxArea = 0;
-            int maxIdx = -1;
-            for (int i = 0; i < contours.size(); i++) {
-                double area = contourArea(contours[i]);
-                if (area > maxArea) {
-                    maxArea = area;
-                    maxIdx = i;
-                }
-            }
+        if (d->locked) {
+            Rect box = d->box;
 
-            if (maxIdx != -1 && maxArea > 500) { 
+            Scalar hudColor(0, 255, 0);
 
-              Rect box = boundingRect(contours[maxIdx]);
-                
-                Scalar hudColor(0, 255, 0); 
-                
-                rectangle(frame, box, hudColor, 2);
+            rectangle(frame, box, hudColor, 2);
 
-                int cx = box.x + box.width / 2;
-                int cy = box.y + box.height / 2;
-                line(frame, Point(cx - 10, cy), Point(cx + 10, cy), hudColor, 2);
-                line(frame, Point(cx, cy - 10), Point(cx, cy + 10), hudColor, 2);
+            int cx = box.x + box.width / 2;
+            int cy = box.y + box.height / 2;
+            line(frame, Point(cx - 10, cy), Point(cx + 10, cy), hudColor, 2);
+            line(frame, Point(cx, cy - 10), Point(cx, cy + 10), hudColor, 2);
 
-                string coords = "X:" + to_string(cx) + " Y:" + to_string(cy);
-                putText(frame, "TARGET LOCKED [ACTIVE]", Point(box.x, box.y - 25), FONT_HERSHEY_SIMPLEX, 0.6, hudColor, 2);
-                putText(frame, coords, Point(box.x, box.y - 10), FONT_HERSHEY_PLAIN, 1, hudColor, 1);
-            }
+            string coords = "X:" + to_string(cx) + " Y:" + to_string(cy);
+            putText(frame, d->coasting ? "TARGET LOCKED [COAST]" : "TARGET LOCKED [ACTIVE]", Point(box.x, box.y - 25), FONT_HERSHEY_SIMPLEX, 0.6, hudColor, 2);
+            putText(frame, coords, Point(box.x, box.y - 10), FONT_HERSHEY_PLAIN, 1, hudColor, 1);
         } else {
             putText(frame, "SCANNING...", Point(50, 50), FONT_HERSHEY_SIMPLEX, 1, Scalar(0, 0, 255), 2);
         }
 
+        ADS_LAP(frameLaps, HUD);
         imshow("Defense Tech Tracker - C++", frame);
-        
-        
-        if (waitKey(30) == 27) break;
+        ADS_LAP(frameLaps, IMSHOW);
+
+        if (pollKey() == 27) break;
     }
 
+    pipeline.stop();
+    PipelineStats stats = pipeline.stats();
+    cout << "captured " << stats.captured << ", dropped before detection " << stats.captureDropped
+         << ", dropped before display " << stats.detectDropped
+         << ", mean capture-to-display " << stats.latencyMs << " ms" << endl;
     cap.release();
     destroyAllWindows();
     return 0;
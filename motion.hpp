@@ -0,0 +1,161 @@
+#pragma once
+
+// Change-driven detection for long scanning periods. A static sky gives the
+// same mask every frame, so the colour pass only has to run where the image
+// moved. A luma thumbnail (1/8 scale) is compared, per 64x64 tile, with the
+// thumbnail of the frame the tile was last classified on. Tiles that moved,
+// tiles under active tracks and, every refreshFrames frames, all tiles are
+// classified again into persistent full-frame masks; the rest keep their
+// bits. Blobs are extracted again only when some tile was classified,
+// otherwise the boxes of the last call are returned as they are.
+//
+// Tiles are a multiple of 64 px wide, so a tile is whole words of a BitMask
+// row and is copied in without shifting. With tilesAcross set, they grow with
+// the frame, so a 4K capture frame gets about as coarse a change map as the
+// 1024x600 view.
+
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include "bitmask.hpp"
+#include "blobs.hpp"
+#include "classify.hpp"
+#include "detect.hpp"
+#include "telemetry.hpp"
+
+struct IncrementalConfig {
+    int tile = 64;              // px, a multiple of 64 and of scale
+    int scale = 8;              // the luma thumbnail is 1/scale of the frame
+    int tilesAcross = 0;        // > 0: about this many tiles per row whatever the frame
+                                // width, each 8x8 thumbnail pixels (tile, scale ignored)
+    int threshold = 12;         // largest thumbnail luma change of a static tile
+    int refreshFrames = 30;     // every n-th call classifies every tile, 0 = never
+};
+
+class IncrementalDetector {
+public:
+    explicit IncrementalDetector(IncrementalConfig cfg = IncrementalConfig()) : cfg_(cfg) {
+        CV_Assert(cfg_.tile > 0 && cfg_.tile % 64 == 0 && cfg_.scale > 0 && cfg_.tile % cfg_.scale == 0);
+    }
+
+    // Appends the box and class ID (1..) of every blob above minArea in bgr.
+    // Tiles touching one of the 'active' rects are always classified again.
+    void detect(const cv::Mat& bgr, const ColorClassifier& classifier, const std::vector<cv::Rect>& active,
+                double minArea, std::vector<cv::Rect>& boxes, std::vector<int>& classes) {
+        CV_Assert(bgr.type() == CV_8UC3);
+        bool reset = bgr.size() != size_ || (int)masks_.size() != classifier.classCount();
+        if (reset) allocate(bgr.size(), classifier.classCount());
+        bool refresh = reset || (cfg_.refreshFrames > 0 && ++sinceRefresh_ >= cfg_.refreshFrames);
+        if (refresh) sinceRefresh_ = 0;
+
+        // Largest luma change of every tile against its reference
+        cv::resize(bgr, small_, thumb_, 0, 0, cv::INTER_AREA);
+        cv::cvtColor(small_, luma_, cv::COLOR_BGR2GRAY);
+        cv::absdiff(luma_, reference_, diff_);
+        const int t = tile_ / scale_;
+        std::fill(change_.begin(), change_.end(), 0);
+        for (int y = 0; y < thumb_.height; y++) {
+            const uchar* d = diff_.ptr<uchar>(y);
+            uchar* c = &change_[(y / t) * cols_];
+            for (int x = 0; x < thumb_.width; x++) c[x / t] = std::max(c[x / t], d[x]);
+        }
+        for (int i = 0; i < cols_ * rows_; i++) dirty_[i] = refresh || change_[i] > cfg_.threshold;
+        for (const cv::Rect& r : active) {
+            cv::Rect a = r & cv::Rect(cv::Point(), size_);
+            if (a.empty()) continue;
+            for (int ty = a.y / tile_; ty <= (a.br().y - 1) / tile_; ty++)
+                for (int tx = a.x / tile_; tx <= (a.br().x - 1) / tile_; tx++) dirty_[ty * cols_ + tx] = 1;
+        }
+
+        // Runs of dirty tiles along each tile row, classified in parallel
+        runs_.clear();
+        int dirtyTiles = 0;
+        for (int ty = 0; ty < rows_; ty++)
+            for (int tx = 0; tx < cols_;) {
+                if (!dirty_[ty * cols_ + tx]) {
+                    tx++;
+                    continue;
+                }
+                int end = tx;
+                while (end < cols_ && dirty_[ty * cols_ + end]) end++;
+                dirtyTiles += end - tx;
+                runs_.push_back(cv::Rect(tx * tile_, ty * tile_, (end - tx) * tile_, tile_) &
+                                cv::Rect(cv::Point(), size_));
+                tx = end;
+            }
+        int total = cols_ * rows_;
+        tiles_ += total;
+        skipped_ += total - dirtyTiles;
+        ADS_COUNT(TILES, total);
+        ADS_COUNT(TILES_SKIPPED, total - dirtyTiles);
+
+        if (dirtyTiles) {
+            if (scratch_.size() < runs_.size()) scratch_.resize(runs_.size());
+            cv::parallel_for_(cv::Range(0, (int)runs_.size()), [&](const cv::Range& range) {
+                for (int k = range.start; k < range.end; k++) {
+                    const cv::Rect& run = runs_[k];
+                    std::vector<BitMask>& out = scratch_[k];
+                    classifier.masks(bgr(run), out);
+                    for (size_t c = 0; c < out.size(); c++)
+                        for (int y = 0; y < run.height; y++)
+                            std::memcpy(masks_[c].row(run.y + y) + run.x / 64, out[c].row(y),
+                                        out[c].stride() * sizeof(uint64_t));
+                }
+            }, (double)runs_.size());
+            for (const cv::Rect& run : runs_) {
+                cv::Rect r(run.x / scale_, run.y / scale_, (run.width + scale_ - 1) / scale_,
+                           (run.height + scale_ - 1) / scale_);
+                r &= cv::Rect(cv::Point(), thumb_);
+                luma_(r).copyTo(reference_(r));
+            }
+
+            boxes_.clear();
+            classes_.clear();
+            classBlobs(masks_, cv::Point(), minArea, boxes_, classes_, extractor_);
+        }
+        boxes.insert(boxes.end(), boxes_.begin(), boxes_.end());
+        classes.insert(classes.end(), classes_.begin(), classes_.end());
+    }
+
+    // Tiles seen and tiles left alone since the start.
+    int64_t tiles() const { return tiles_; }
+    int64_t skipped() const { return skipped_; }
+    double skippedFraction() const { return tiles_ ? (double)skipped_ / tiles_ : 0; }
+
+private:
+    void allocate(cv::Size size, int classCount) {
+        size_ = size;
+        tile_ = cfg_.tile;
+        scale_ = cfg_.scale;
+        if (cfg_.tilesAcross > 0) {
+            // nearest multiple of 64: 1024 px gives 16 tiles of 64, 1920 px 15 of
+            // 128, 3840 px 15 of 256; small frames get more (1280 px: 20 of 64)
+            tile_ = std::max(1, (size.width / cfg_.tilesAcross + 32) / 64) * 64;
+            scale_ = tile_ / 8;
+        }
+        cols_ = (size.width + tile_ - 1) / tile_;
+        rows_ = (size.height + tile_ - 1) / tile_;
+        thumb_ = cv::Size((size.width + scale_ - 1) / scale_, (size.height + scale_ - 1) / scale_);
+        reference_.create(thumb_, CV_8UC1);
+        change_.assign(cols_ * rows_, 0);
+        dirty_.assign(cols_ * rows_, 1);
+        masks_.resize(classCount);
+        for (BitMask& m : masks_) m.create(size.height, size.width);
+    }
+
+    IncrementalConfig cfg_;
+    cv::Size size_, thumb_;
+    int tile_ = 0, scale_ = 0;
+    int cols_ = 0, rows_ = 0;
+    int sinceRefresh_ = 0;
+    cv::Mat small_, luma_, reference_, diff_;
+    std::vector<uchar> change_, dirty_;
+    std::vector<cv::Rect> runs_;
+    std::vector<std::vector<BitMask>> scratch_;
+    std::vector<BitMask> masks_;
+    BlobExtractor extractor_;
+    std::vector<cv::Rect> boxes_;
+    std::vector<int> classes_;
+    int64_t tiles_ = 0, skipped_ = 0;
+};
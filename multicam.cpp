@@ -0,0 +1,239 @@
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "replay.hpp"
+#include "classify.hpp"
+#include "tracks.hpp"
+#include "hud.hpp"
+#include "telemetry.hpp"
+#include "multicam.hpp"
+
+using namespace cv;
+using namespace std;
+
+// Watches every source given on the command line at once and keeps one
+// fused track picture over all of them.
+//
+// multicam [--headless] [--frames <n>] [--classes <file>] [--sensor-map <file>]
+//          [--telemetry <file>] source ...
+// Live: 't' switches between tiles and the primary view, 1-9 pick the
+// primary sensor, TAB cycles the engaged track, ESC quits.
+// Headless: runs every source to the end (or --frames) as fast as it can and
+// prints the frame rate per sensor and in total.
+
+static bool isCameraIndex(const string& s) {
+    return !s.empty() && all_of(s.begin(), s.end(), ::isdigit);
+}
+
+// Fused tracks drawn into the part of the canvas showing sensor 'fromWorld'
+// maps into, scaled by 'scale' and placed at 'origin'.
+static void drawTracks(Mat& canvas, const vector<Track>& tracks, const Track* engaged, const Matx33f& fromWorld,
+                       Point origin, float scale, Rect clip, const ColorClassifier& classifier) {
+    Scalar red(0, 0, 255), white(200, 200, 200);
+    char text[64];
+    for (const Track& t : tracks) {
+        if (!t.visible()) continue;
+        Rect b = mapBox(fromWorld, t.box);
+        b = Rect(origin.x + cvRound(b.x * scale), origin.y + cvRound(b.y * scale), cvRound(b.width * scale),
+                 cvRound(b.height * scale));
+        if ((b & clip).empty()) continue;
+        bool lock = &t == engaged;
+        Scalar color = lock ? red : white;
+        drawBracket(canvas, b.x - 5, b.y - 5, b.width + 10, b.height + 10, color);
+        snprintf(text, sizeof(text), lock ? "LOCK T%d %s" : "T%d %s", t.id, classifier.name(t.cls).c_str());
+        putText(canvas, text, Point(b.x, b.y - 10), FONT_HERSHEY_PLAIN, 1, color, 1);
+    }
+}
+
+int main(int argc, char** argv) {
+    ReplayOptions opt = parseReplayArgs(argc, argv);
+    if (opt.sources.empty()) {
+        cerr << "usage: multicam [--headless] [--frames <n>] [--classes <file>] [--sensor-map <file>] source ..." << endl;
+        return -1;
+    }
+    if (opt.sources.size() > DetectionFusion::MAX_SENSORS) {
+        cerr << "Error: at most " << DetectionFusion::MAX_SENSORS << " sensors" << endl;
+        return -1;
+    }
+
+    ColorClassifier classifier;
+    loadTargetClasses(opt.classesPath, classifier);
+
+    // The sensors are the unit of parallelism: each worker runs its kernels
+    // on its own core instead of every worker spreading over all of them
+    int sensorCount = (int)opt.sources.size();
+    int cores = max(1, (int)thread::hardware_concurrency());
+    if (sensorCount > 1) setNumThreads(1);
+
+    vector<SensorConfig> configs(sensorCount);
+    for (int i = 0; i < sensorCount; i++) {
+        SensorConfig& c = configs[i];
+        c.source = opt.sources[i];
+        c.maxFrames = opt.maxFrames;
+        c.paceFps = opt.headless || isCameraIndex(c.source) ? 0 : 30;   // files play in real time when watched
+        c.core = sensorCount <= cores ? i : -1;
+    }
+    if (!opt.sensorMapPath.empty()) loadSensorMap(opt.sensorMapPath, configs);
+    vector<Matx33f> fromWorld;
+    for (const SensorConfig& c : configs) fromWorld.push_back(c.toWorld.inv());
+
+    vector<unique_ptr<SensorWorker>> workers;
+    for (const SensorConfig& c : configs) workers.emplace_back(new SensorWorker(c, classifier));
+
+    Size world = configs[0].size;
+    TrackManager tracks;
+    DetectionFusion fusion;
+    vector<Rect> detections;
+    vector<int> detectionClasses;
+    vector<const SensorReport*> latest(sensorCount, nullptr);
+    vector<int64_t> usedSeq(sensorCount, -1);   // last report of each sensor already fused
+    const float mergeRadius = 40;
+    const double staleTicks = 0.15 * getTickFrequency();   // reports older than this are left out
+    const double frameTicks = getTickFrequency() / 30;     // longest wait for a slow sensor
+    int64 lastStep = getTickCount();
+
+    // One TrackManager step per frame: once every running sensor has a report
+    // the fusion has not used yet, or a frame time after the last step with
+    // whatever has arrived. Every report is fused once, so the motion models
+    // step at the frame rate however many sensors there are.
+    auto fuse = [&]() {
+        int fresh = 0, waiting = 0;
+        for (int i = 0; i < sensorCount; i++) {
+            if (const SensorReport* r = workers[i]->next()) latest[i] = r;
+            if (latest[i] && latest[i]->seq != usedSeq[i]) fresh++;
+            else if (!workers[i]->finished()) waiting++;
+        }
+        int64 now = getTickCount();
+        if (!fresh || (waiting && now - lastStep < frameTicks)) return false;
+        lastStep = now;
+        ADS_TIME_STAGE(TRACKING);
+        fusion.clear();
+        for (int i = 0; i < sensorCount; i++) {
+            const SensorReport* r = latest[i];
+            if (!r || r->seq == usedSeq[i]) continue;
+            usedSeq[i] = r->seq;
+            if (now - r->captureTick > staleTicks) continue;
+            for (size_t k = 0; k < r->boxes.size(); k++)
+                fusion.add(mapBox(configs[i].toWorld, r->boxes[k]), r->classes[k], i, mergeRadius);
+        }
+        fusion.result(detections, detectionClasses);
+        tracks.predict(world);
+        tracks.update(detections, detectionClasses);
+        return true;
+    };
+
+    int64 start = getTickCount();
+    for (auto& w : workers) w->start();
+
+    if (opt.headless) {
+        int64_t steps = 0;
+        while (true) {
+            bool done = all_of(workers.begin(), workers.end(), [](const unique_ptr<SensorWorker>& w) { return w->finished(); });
+            if (fuse()) steps++;
+            else if (done) break;
+            else this_thread::sleep_for(chrono::milliseconds(1));
+        }
+        double seconds = (getTickCount() - start) / getTickFrequency();
+        int64_t total = 0;
+        for (int i = 0; i < sensorCount; i++) {
+            const SensorWorker& w = *workers[i];
+            total += w.frames();
+            printf("sensor %d %-24s %7lld frames  %7.1f fps  %6.2f ms/frame busy%s\n", i + 1, configs[i].source.c_str(),
+                   (long long)w.frames(), w.frames() / seconds, w.frames() ? w.busySeconds() * 1000 / w.frames() : 0.0,
+                   configs[i].core >= 0 ? "" : "  (not pinned)");
+        }
+        printf("%d sensors on %d cores: %.1f frames/s in total over %.2f s, %lld fusion steps, %d tracks at the end\n",
+               sensorCount, cores, total / seconds, seconds, (long long)steps, (int)tracks.tracks().size());
+        return 0;
+    }
+
+    Scalar cyan(255, 255, 0), white(200, 200, 200), red(0, 0, 255);
+    Mat canvas(world, CV_8UC3);
+    bool tiles = sensorCount > 1;
+    int primary = 0;
+    vector<int64_t> lastFrames(sensorCount, 0);
+    vector<double> fps(sensorCount, 0);
+    int64 lastRate = getTickCount();
+    TelemetryWriter telemetryLog(opt.telemetryPath);
+    char text[64];
+    namedWindow("ADS_MULTICAM", WINDOW_NORMAL);
+    resizeWindow("ADS_MULTICAM", 1280, 750);
+
+    while (true) {
+        bool done = all_of(workers.begin(), workers.end(), [](const unique_ptr<SensorWorker>& w) { return w->finished(); });
+        if (!fuse()) {
+            if (done) break;
+            if (pollKey() == 27) break;
+            this_thread::sleep_for(chrono::milliseconds(2));
+            continue;
+        }
+        ADS_TIME_STAGE(FRAME);
+        ADS_COUNT(FRAMES, 1);
+        int64 now = getTickCount();
+        if (now - lastRate > getTickFrequency()) {
+            double dt = (now - lastRate) / getTickFrequency();
+            for (int i = 0; i < sensorCount; i++) {
+                fps[i] = (workers[i]->frames() - lastFrames[i]) / dt;
+                lastFrames[i] = workers[i]->frames();
+            }
+            lastRate = now;
+        }
+
+        const Track* engaged = tracks.engaged();
+        canvas.setTo(Scalar(0, 0, 0));
+        if (tiles) {
+            int cols = (int)ceil(sqrt((double)sensorCount)), rows = (sensorCount + cols - 1) / cols;
+            Size tile(world.width / cols, world.height / rows);
+            float scale = min(tile.width / (float)world.width, tile.height / (float)world.height);
+            for (int i = 0; i < sensorCount; i++) {
+                Rect r((i % cols) * tile.width, (i / cols) * tile.height, cvRound(world.width * scale),
+                       cvRound(world.height * scale));
+                if (latest[i]) resize(latest[i]->frame, canvas(r), r.size());
+                drawTracks(canvas, tracks.tracks(), engaged, fromWorld[i], r.tl(), scale, r, classifier);
+                rectangle(canvas, r, i == primary ? cyan : white, 1);
+                snprintf(text, sizeof(text), "S%d %.0f FPS", i + 1, fps[i]);
+                putText(canvas, text, r.tl() + Point(5, 15), FONT_HERSHEY_PLAIN, 1, cyan, 1);
+            }
+        } else {
+            Rect full(Point(), world);
+            if (latest[primary]) latest[primary]->frame.copyTo(canvas);
+            drawTracks(canvas, tracks.tracks(), engaged, fromWorld[primary], Point(), 1, full, classifier);
+            // the other sensors as thumbnails along the top right
+            Size thumb(world.width / 5, world.height / 5);
+            for (int i = 0, slot = 0; i < sensorCount; i++) {
+                if (i == primary) continue;
+                Rect r(world.width - (++slot) * (thumb.width + 5), 5, thumb.width, thumb.height);
+                if (r.x < 0) break;
+                if (latest[i]) resize(latest[i]->frame, canvas(r), thumb);
+                rectangle(canvas, r, white, 1);
+                snprintf(text, sizeof(text), "S%d", i + 1);
+                putText(canvas, text, r.tl() + Point(3, 12), FONT_HERSHEY_PLAIN, 0.9, cyan, 1);
+            }
+            snprintf(text, sizeof(text), "S%d %.0f FPS", primary + 1, fps[primary]);
+            putText(canvas, text, Point(10, 20), FONT_HERSHEY_PLAIN, 1.2, cyan, 1);
+        }
+        int visible = (int)count_if(tracks.tracks().begin(), tracks.tracks().end(), [](const Track& t) { return t.visible(); });
+        snprintf(text, sizeof(text), "SENSORS %d  TRACKS %d", sensorCount, visible);
+        putText(canvas, text, Point(10, world.height - 10), FONT_HERSHEY_PLAIN, 1.2, engaged ? red : cyan, 1);
+        imshow("ADS_MULTICAM", canvas);
+
+        int key = pollKey();
+        if (key == 27) break;
+        if (key == 't') tiles = !tiles;
+        if (key == 9) tracks.cycleEngaged();
+        if (key >= '1' && key <= '9' && key - '1' < sensorCount) {
+            primary = key - '1';
+            tiles = false;
+        }
+    }
+
+    for (auto& w : workers) w->stop();
+    destroyAllWindows();
+    return 0;
+}
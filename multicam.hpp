@@ -0,0 +1,235 @@
+#pragma once
+
+// Several sensors in one process. Every sensor has a worker thread, pinned
+// to a core of its own where the machine has enough, that captures, scales
+// and classifies its frames and publishes frame + detections through a
+// LatestQueue (pipeline.hpp). The consumer takes the newest report of every
+// sensor, maps the detections into a shared world picture and merges the
+// ones several sensors see into one, so a single TrackManager holds the
+// fused track picture.
+
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "bitmask.hpp"
+#include "classify.hpp"
+#include "detect.hpp"
+#include "pipeline.hpp"
+#include "replay.hpp"
+#include "telemetry.hpp"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// Best effort; a no-op where affinity cannot be set.
+inline void pinThread(std::thread& t, int core) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core, &set);
+    pthread_setaffinity_np(t.native_handle(), sizeof(set), &set);
+#else
+    (void)t;
+    (void)core;
+#endif
+}
+
+struct SensorReport {
+    cv::Mat frame;                  // scaled to the world size
+    std::vector<cv::Rect> boxes;    // detections in sensor (= frame) coordinates
+    std::vector<int> classes;       // class ID of each box
+    int64_t seq = 0, captureTick = 0;
+};
+
+struct SensorConfig {
+    std::string source;             // camera index, file, pattern or directory (FrameSource)
+    cv::Size size{1024, 600};       // frames are scaled to this before detection
+    cv::Matx33f toWorld = cv::Matx33f::eye();   // sensor -> world homography
+    double paceFps = 0;             // play files at this rate, 0 = as fast as possible
+    int maxFrames = 0;              // 0 = until the source ends
+    double minArea = 400;
+    int core = -1;                  // core to pin the worker to, -1 = none
+};
+
+class SensorWorker {
+public:
+    SensorWorker(const SensorConfig& cfg, const ColorClassifier& classifier)
+        : cfg_(cfg), classifier_(classifier), source_({cfg.source}) {}
+    ~SensorWorker() { stop(); }
+
+    void start() {
+        running_ = true;
+        thread_ = std::thread([this] { run(); });
+        if (cfg_.core >= 0) pinThread(thread_, cfg_.core);
+    }
+
+    void stop() {
+        running_ = false;
+        if (thread_.joinable()) thread_.join();
+    }
+
+    const SensorConfig& config() const { return cfg_; }
+
+    // Consumer side: newest report, if a new one arrived since the last call.
+    // Valid until the next successful call.
+    const SensorReport* next() { return reports_.acquire() ? &reports_.front() : nullptr; }
+
+    bool finished() const { return finished_; }
+    int64_t frames() const { return frames_; }
+    double busySeconds() const { return busyTicks_ / cv::getTickFrequency(); }
+
+private:
+    void run() {
+        auto nextFrame = std::chrono::steady_clock::now();
+        while (running_ && (cfg_.maxFrames <= 0 || frames_ < cfg_.maxFrames)) {
+            if (cfg_.paceFps > 0) {
+                std::this_thread::sleep_until(nextFrame);
+                nextFrame += std::chrono::microseconds((int64_t)(1e6 / cfg_.paceFps));
+            }
+            int64_t t0 = cv::getTickCount();
+            SensorReport& r = reports_.back();
+            {
+                ADS_TIME_STAGE(CAPTURE);
+                if (!source_.read(raw_)) break;
+            }
+            {
+                ADS_TIME_STAGE(CONDITION);
+                cv::resize(raw_, r.frame, cfg_.size);
+            }
+            r.boxes.clear();
+            r.classes.clear();
+            {
+                ADS_TIME_STAGE(THRESHOLD);
+                classifier_.masks(r.frame, masks_);
+            }
+            {
+                ADS_TIME_STAGE(BLOBS);
+                classBlobs(masks_, cv::Point(), cfg_.minArea, r.boxes, r.classes, blobs_);
+            }
+            r.captureTick = t0;
+            r.seq = frames_;
+            if (reports_.publish()) ADS_COUNT(DETECT_DROPPED, 1);
+            busyTicks_ += cv::getTickCount() - t0;
+            frames_++;
+        }
+        finished_ = true;
+    }
+
+    SensorConfig cfg_;
+    const ColorClassifier& classifier_;
+    FrameSource source_;
+    cv::Mat raw_;
+    std::vector<BitMask> masks_;
+    BlobExtractor blobs_;
+    LatestQueue<SensorReport> reports_;
+    std::thread thread_;
+    std::atomic<bool> running_{false}, finished_{false};
+    std::atomic<int64_t> frames_{0}, busyTicks_{0};
+};
+
+// Bounding box of r mapped through homography h.
+inline cv::Rect mapBox(const cv::Matx33f& h, const cv::Rect& r) {
+    if (h == cv::Matx33f::eye()) return r;
+    float xs[2] = {(float)r.x, (float)(r.x + r.width)}, ys[2] = {(float)r.y, (float)(r.y + r.height)};
+    float x0 = FLT_MAX, y0 = FLT_MAX, x1 = -FLT_MAX, y1 = -FLT_MAX;
+    for (float x : xs)
+        for (float y : ys) {
+            cv::Vec3f p = h * cv::Vec3f(x, y, 1);
+            float w = std::abs(p[2]) > 1e-6f ? p[2] : 1e-6f;
+            x0 = std::min(x0, p[0] / w);
+            x1 = std::max(x1, p[0] / w);
+            y0 = std::min(y0, p[1] / w);
+            y1 = std::max(y1, p[1] / w);
+        }
+    return cv::Rect(cvRound(x0), cvRound(y0), cvRound(x1 - x0), cvRound(y1 - y0));
+}
+
+// Detections of all sensors in world coordinates. A box joins the nearest
+// cluster of its class within 'radius' that no box of the same sensor is in
+// yet (a target several sensors see), and each cluster becomes one averaged
+// box. Two targets one sensor sees side by side stay two detections.
+class DetectionFusion {
+public:
+    enum { MAX_SENSORS = 64 };
+
+    void clear() { clusters_.clear(); }
+
+    void add(const cv::Rect& box, int cls, int sensor, float radius) {
+        CV_Assert(sensor >= 0 && sensor < MAX_SENSORS);
+        const uint64_t bit = 1ull << sensor;
+        cv::Point2f c(box.x + box.width / 2.f, box.y + box.height / 2.f);
+        Cluster* best = nullptr;
+        float bestDist = radius * radius;
+        for (Cluster& k : clusters_) {
+            if (k.cls != cls || (k.sensors & bit)) continue;
+            cv::Point2f d = k.centre() - c;
+            float dist = d.x * d.x + d.y * d.y;
+            if (dist <= bestDist) {
+                best = &k;
+                bestDist = dist;
+            }
+        }
+        cv::Vec4f b((float)box.x, (float)box.y, (float)box.width, (float)box.height);
+        if (best) {
+            best->sum += b;
+            best->n++;
+            best->sensors |= bit;
+            return;
+        }
+        Cluster k;
+        k.sum = b;
+        k.n = 1;
+        k.cls = cls;
+        k.sensors = bit;
+        clusters_.push_back(k);
+    }
+
+    void result(std::vector<cv::Rect>& boxes, std::vector<int>& classes) const {
+        boxes.clear();
+        classes.clear();
+        for (const Cluster& k : clusters_) {
+            cv::Vec4f b = k.sum / (float)k.n;
+            boxes.push_back(cv::Rect(cvRound(b[0]), cvRound(b[1]), cvRound(b[2]), cvRound(b[3])));
+            classes.push_back(k.cls);
+        }
+    }
+
+private:
+    struct Cluster {
+        cv::Vec4f sum;
+        int n = 0, cls = 0;
+        uint64_t sensors = 0;   // bit per sensor with a box in the cluster
+        cv::Point2f centre() const { return cv::Point2f((sum[0] + sum[2] / 2) / n, (sum[1] + sum[3] / 2) / n); }
+    };
+    std::vector<Cluster> clusters_;
+};
+
+// One homography per line, 9 numbers row by row (sensor -> world); lines
+// beyond the sensor count are ignored, missing ones stay identity.
+inline void loadSensorMap(const std::string& path, std::vector<SensorConfig>& sensors) {
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "Warning: could not read sensor map " << path << std::endl;
+        return;
+    }
+    std::string line;
+    for (size_t i = 0; i < sensors.size() && std::getline(in, line);) {
+        if (line.empty() || line[0] == '#') continue;
+        std::istringstream ss(line);
+        cv::Matx33f h;
+        for (int k = 0; k < 9; k++) ss >> h.val[k];
+        if (ss) sensors[i].toWorld = h;
+        else std::cerr << "Warning: bad sensor map line: " << line << std::endl;
+        i++;
+    }
+}
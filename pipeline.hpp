@@ -0,0 +1,178 @@
+#pragma once
+
+// Threaded capture -> detect -> render pipeline. Capture and detection each
+// run on their own thread; the caller's thread renders. Stages are joined by
+// LatestQueue, a lock-free three-slot buffer where a newer item replaces one
+// that has not been picked up yet, so every stage always works on the newest
+// frame and stale frames are dropped (and counted) instead of queueing up.
+
+#include <opencv2/opencv.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include "telemetry.hpp"
+
+template <typename T>
+class LatestQueue {
+public:
+    // Producer side: fill back(), then publish() it.
+    T& back() { return slots_[back_]; }
+
+    // Returns true when the previously published item was never consumed.
+    bool publish() {
+        // seq_cst pairs with the consumer's store to waiting_ / load of middle_
+        int prev = middle_.exchange(back_ | FRESH);
+        back_ = prev & INDEX;
+        if (waiting_.load()) {
+            std::lock_guard<std::mutex> lock(m_);
+            cv_.notify_one();
+        }
+        return (prev & FRESH) != 0;
+    }
+
+    // Consumer side: swaps in the newest published item, if any. The item
+    // stays valid in front() until the next successful acquire().
+    bool acquire() {
+        if (!(middle_.load(std::memory_order_acquire) & FRESH)) return false;
+        int prev = middle_.exchange(front_, std::memory_order_acq_rel);
+        front_ = prev & INDEX;
+        return true;
+    }
+
+    // acquire(), waiting up to 'timeout' for the producer.
+    bool acquire(std::chrono::milliseconds timeout) {
+        if (acquire()) return true;
+        std::unique_lock<std::mutex> lock(m_);
+        waiting_.store(true);
+        cv_.wait_for(lock, timeout, [&] { return (middle_.load() & FRESH) != 0; });
+        waiting_.store(false);
+        lock.unlock();
+        return acquire();
+    }
+
+    // Consumer side: a published item is waiting for acquire().
+    bool pending() const { return (middle_.load() & FRESH) != 0; }
+
+    T& front() { return slots_[front_]; }
+
+private:
+    enum { INDEX = 3, FRESH = 4 };
+    T slots_[3];
+    int back_ = 0, front_ = 1;
+    std::atomic<int> middle_{2};
+    std::atomic<bool> waiting_{false};
+    std::mutex m_;
+    std::condition_variable cv_;
+};
+
+struct FramePacket {
+    cv::Mat frame;
+    cv::Mat display;   // optional copy prepared for the renderer
+    int buffer = -1;   // capture buffer 'frame' points into, for zero-copy sources
+    int64_t seq = 0;
+    int64_t captureTick = 0;
+};
+
+struct PipelineStats {
+    int64_t captured = 0, detected = 0, rendered = 0;
+    int64_t captureDropped = 0;   // captured frames detection never saw
+    int64_t detectDropped = 0;    // detection results that were never rendered
+    double latencyMs = 0;         // mean capture -> handed to the renderer
+};
+
+// Result must have the members of FramePacket (frame, seq, captureTick) plus
+// whatever detect() fills in.
+template <typename Result>
+class FramePipeline {
+public:
+    typedef std::function<bool(FramePacket&)> CaptureFn;         // fills frame (and display); false = end of stream
+    typedef std::function<void(FramePacket&, Result&)> DetectFn;  // may swap packet.frame into the result
+
+    FramePipeline(CaptureFn capture, DetectFn detect) : capture_(std::move(capture)), detect_(std::move(detect)) {}
+    ~FramePipeline() { stop(); }
+
+    void start() {
+        running_ = true;
+        captureThread_ = std::thread([this] { captureLoop(); });
+        detectThread_ = std::thread([this] { detectLoop(); });
+    }
+
+    void stop() {
+        running_ = false;
+        if (captureThread_.joinable()) captureThread_.join();
+        if (detectThread_.joinable()) detectThread_.join();
+    }
+
+    // True once the sources are exhausted, the last frame went through
+    // detection and its result was taken by next(). finished_ is set after
+    // the last publish, so a result still pending is seen here.
+    bool finished() const { return finished_ && !results_.pending(); }
+
+    // Newest detection result not rendered yet, or nullptr if none arrived
+    // within 'timeout'. Valid until the next call.
+    Result* next(std::chrono::milliseconds timeout) {
+        if (!results_.acquire(timeout)) return nullptr;
+        rendered_++;
+        latencyTicks_ += cv::getTickCount() - results_.front().captureTick;
+        return &results_.front();
+    }
+
+    PipelineStats stats() const {
+        PipelineStats s;
+        s.captured = captured_;
+        s.detected = detected_;
+        s.rendered = rendered_;
+        s.captureDropped = captureDropped_;
+        s.detectDropped = detectDropped_;
+        if (s.rendered > 0) s.latencyMs = latencyTicks_ * 1000.0 / cv::getTickFrequency() / s.rendered;
+        return s;
+    }
+
+private:
+    void captureLoop() {
+        while (running_) {
+            FramePacket& p = frames_.back();
+            if (!capture_(p) || p.frame.empty()) break;
+            p.captureTick = cv::getTickCount();
+            p.seq = captured_++;
+            if (frames_.publish()) {
+                captureDropped_++;
+                ADS_COUNT(CAPTURE_DROPPED, 1);
+            }
+        }
+        captureDone_ = true;
+    }
+
+    void detectLoop() {
+        while (running_) {
+            if (!frames_.acquire(std::chrono::milliseconds(10))) {
+                if (!captureDone_) continue;
+                if (!frames_.acquire()) break;   // last frame published just before capture ended
+            }
+            FramePacket& p = frames_.front();
+            Result& r = results_.back();
+            detect_(p, r);
+            r.seq = p.seq;
+            r.captureTick = p.captureTick;
+            detected_++;
+            if (results_.publish()) {
+                detectDropped_++;
+                ADS_COUNT(DETECT_DROPPED, 1);
+            }
+        }
+        finished_ = true;
+    }
+
+    CaptureFn capture_;
+    DetectFn detect_;
+    LatestQueue<FramePacket> frames_;
+    LatestQueue<Result> results_;
+    std::thread captureThread_, detectThread_;
+    std::atomic<bool> running_{false}, captureDone_{false}, finished_{false};
+    std::atomic<int64_t> captured_{0}, detected_{0}, rendered_{0}, captureDropped_{0}, detectDropped_{0};
+    std::atomic<int64_t> latencyTicks_{0};
+};
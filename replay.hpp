@@ -0,0 +1,387 @@
+#pragma once
+
+// Headless replay: runs the detection pipeline over recorded footage as fast
+// as possible (no imshow, no waitKey) and reports per-stage latency.
+
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "condition.hpp"
+#include "detect.hpp"
+#include "threshold.hpp"
+#include "tracker.hpp"
+#include "yuv.hpp"
+
+struct DetectorConfig {
+    cv::Scalar lowerColor{100, 150, 0};
+    cv::Scalar upperColor{140, 255, 255};
+    double minArea = 400;
+    bool morphology = false;
+    ConditionConfig condition;   // mirror, scale and HUD shading before detection
+};
+
+struct ReplayOptions {
+    bool headless = false;
+    std::string reportPath;
+    int maxFrames = 0;    // 0 = until every source is exhausted
+    bool legacyThreshold = false;   // time cvtColor + inRange instead of bgrToMask
+    bool verifyThreshold = false;   // run both and count mismatching mask pixels
+    bool roiTracking = false;       // search only the predicted window while locked
+    bool legacyCondition = false;   // time flip + resize + tint + scanlines instead of FrameConditioner
+    bool verifyCondition = false;   // run both and count mismatching frame / display pixels
+    bool legacyMask = false;        // byte-per-pixel mask and cv::erode / dilate instead of BitMask
+    bool verifyMask = false;        // run both morphologies and count mismatching mask pixels
+    bool legacyBlobs = false;       // time findContours + contourArea instead of BlobExtractor
+    bool verifyBlobs = false;       // run both and count frames where the selected blob differs
+    std::string telemetryPath;      // live mode: per-second stage figures (.csv, otherwise JSON lines)
+    std::string yuvSource;          // live mode: detect on raw YUV from a V4L2 device or a .yuv file
+    YuvFormat yuvFormat = YuvFormat::YUYV;
+    cv::Size yuvSize{1280, 720};
+    int yuvFps = 30;
+    std::string classesPath;        // live mode: target colour classes for classify.hpp
+    std::string journalPath;        // live mode: per-frame session journal (journal.hpp)
+    uint64_t journalFrames = 108000;   // journal ring size, an hour at 30 fps
+    std::string sensorMapPath;      // multicam: sensor -> world homographies, one per line
+    bool fullResolution = false;    // live mode: detect on the capture frame in row bands (tiled.hpp)
+    bool incremental = false;       // live mode: classify only the tiles that changed (motion.hpp)
+    int refreshFrames = 30;         // incremental: frames between full refreshes, 0 = never
+    std::vector<std::string> sources;
+};
+
+// prog [--headless] [--report <file.json>] [--frames <n>]
+//      [--legacy-threshold] [--verify-threshold] [--roi]
+//      [--legacy-condition] [--verify-condition]
+//      [--legacy-mask] [--verify-mask] [--legacy-blobs] [--verify-blobs]
+//      [--telemetry <file>] [--yuv </dev/videoN | file.yuv>] [--yuv-format nv12|yuyv]
+//      [--yuv-size <WxH>] [--yuv-fps <n>] [--classes <file>]
+//      [--journal <file>] [--journal-frames <n>] [--sensor-map <file>] [--full-res]
+//      [--incremental] [--refresh <n>] [source ...]
+// A source is a camera index, a video file, an image sequence pattern
+// (frames/img_%04d.png) or a directory of images.
+inline ReplayOptions parseReplayArgs(int argc, char** argv) {
+    ReplayOptions opt;
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        if (a == "--headless") opt.headless = true;
+        else if (a == "--report" && i + 1 < argc) opt.reportPath = argv[++i];
+        else if (a == "--frames" && i + 1 < argc) opt.maxFrames = std::stoi(argv[++i]);
+        else if (a == "--legacy-threshold") opt.legacyThreshold = true;
+        else if (a == "--verify-threshold") opt.verifyThreshold = true;
+        else if (a == "--roi") opt.roiTracking = true;
+        else if (a == "--legacy-condition") opt.legacyCondition = true;
+        else if (a == "--verify-condition") opt.verifyCondition = true;
+        else if (a == "--legacy-mask") opt.legacyMask = true;
+        else if (a == "--verify-mask") opt.verifyMask = true;
+        else if (a == "--legacy-blobs") opt.legacyBlobs = true;
+        else if (a == "--verify-blobs") opt.verifyBlobs = true;
+        else if (a == "--telemetry" && i + 1 < argc) opt.telemetryPath = argv[++i];
+        else if (a == "--yuv" && i + 1 < argc) opt.yuvSource = argv[++i];
+        else if (a == "--yuv-format" && i + 1 < argc)
+            opt.yuvFormat = std::string(argv[++i]) == "nv12" ? YuvFormat::NV12 : YuvFormat::YUYV;
+        else if (a == "--yuv-size" && i + 1 < argc)
+            std::sscanf(argv[++i], "%dx%d", &opt.yuvSize.width, &opt.yuvSize.height);
+        else if (a == "--yuv-fps" && i + 1 < argc) opt.yuvFps = std::stoi(argv[++i]);
+        else if (a == "--classes" && i + 1 < argc) opt.classesPath = argv[++i];
+        else if (a == "--journal" && i + 1 < argc) opt.journalPath = argv[++i];
+        else if (a == "--journal-frames" && i + 1 < argc) opt.journalFrames = std::stoull(argv[++i]);
+        else if (a == "--sensor-map" && i + 1 < argc) opt.sensorMapPath = argv[++i];
+        else if (a == "--full-res") opt.fullResolution = true;
+        else if (a == "--incremental") opt.incremental = true;
+        else if (a == "--refresh" && i + 1 < argc) opt.refreshFrames = std::stoi(argv[++i]);
+        else opt.sources.push_back(a);
+    }
+    return opt;
+}
+
+// Sequential frame reader over a list of sources.
+class FrameSource {
+public:
+    explicit FrameSource(const std::vector<std::string>& sources) : sources_(sources) {}
+
+    bool read(cv::Mat& frame) {
+        while (true) {
+            if (imageIdx_ < images_.size()) {
+                frame = cv::imread(images_[imageIdx_++]);
+                if (!frame.empty()) return true;
+                continue;
+            }
+            if (cap_.isOpened() && cap_.read(frame) && !frame.empty()) return true;
+            if (!openNext()) return false;
+        }
+    }
+
+private:
+    bool openNext() {
+        cap_.release();
+        images_.clear();
+        imageIdx_ = 0;
+        while (next_ < sources_.size()) {
+            const std::string& s = sources_[next_++];
+            if (!s.empty() && std::all_of(s.begin(), s.end(), ::isdigit)) {
+                if (cap_.open(std::stoi(s))) return true;
+            } else if (std::filesystem::is_directory(s)) {
+                cv::glob(s, images_);
+                std::sort(images_.begin(), images_.end());
+                if (!images_.empty()) return true;
+            } else if (cap_.open(s)) {
+                return true;
+            }
+            std::cerr << "Warning: could not open source " << s << std::endl;
+        }
+        return false;
+    }
+
+    std::vector<std::string> sources_;
+    size_t next_ = 0;
+    cv::VideoCapture cap_;
+    std::vector<std::string> images_;
+    size_t imageIdx_ = 0;
+};
+
+// Per-stage latency samples in milliseconds.
+class BenchReport {
+public:
+    explicit BenchReport(std::vector<std::string> stages)
+        : names_(std::move(stages)), samples_(names_.size()) {}
+
+    void add(int stage, double ms) { samples_[stage].push_back(ms); }
+
+    static double percentile(std::vector<double> v, double p) {
+        if (v.empty()) return 0;
+        size_t k = std::min(v.size() - 1, (size_t)(p * (v.size() - 1) + 0.5));
+        std::nth_element(v.begin(), v.begin() + k, v.end());
+        return v[k];
+    }
+
+    // 'total' is the index of the stage holding whole-frame time.
+    void write(std::ostream& table, std::ostream* json, int total, int frames, int detections) const {
+        double totalMs = 0;
+        for (double ms : samples_[total]) totalMs += ms;
+        double fps = totalMs > 0 ? frames * 1000.0 / totalMs : 0;
+
+        table << std::fixed << std::setprecision(3);
+        table << "frames: " << frames << "  detections: " << detections
+              << "  fps: " << std::setprecision(1) << fps << std::setprecision(3) << "\n";
+        table << std::left << std::setw(14) << "stage" << std::right
+              << std::setw(10) << "mean ms" << std::setw(10) << "p50 ms" << std::setw(10) << "p99 ms" << "\n";
+        for (size_t i = 0; i < names_.size(); i++) {
+            if (samples_[i].empty()) continue;
+            table << std::left << std::setw(14) << names_[i] << std::right
+                  << std::setw(10) << mean(i) << std::setw(10) << percentile(samples_[i], 0.50)
+                  << std::setw(10) << percentile(samples_[i], 0.99) << "\n";
+        }
+
+        if (!json) return;
+        *json << std::fixed << std::setprecision(4);
+        *json << "{\n  \"frames\": " << frames << ",\n  \"detections\": " << detections
+              << ",\n  \"fps\": " << fps << ",\n  \"stages\": {\n";
+        bool first = true;
+        for (size_t i = 0; i < names_.size(); i++) {
+            if (samples_[i].empty()) continue;
+            *json << (first ? "" : ",\n") << "    \"" << names_[i] << "\": {\"mean_ms\": " << mean(i)
+                  << ", \"p50_ms\": " << percentile(samples_[i], 0.50)
+                  << ", \"p99_ms\": " << percentile(samples_[i], 0.99) << "}";
+            first = false;
+        }
+        *json << "\n  }\n}\n";
+    }
+
+private:
+    double mean(size_t i) const {
+        if (samples_[i].empty()) return 0;
+        double s = 0;
+        for (double ms : samples_[i]) s += ms;
+        return s / samples_[i].size();
+    }
+
+    std::vector<std::string> names_;
+    std::vector<std::vector<double>> samples_;
+};
+
+// Runs condition -> threshold -> morphology -> largest blob over every frame
+// of opt.sources and writes the report. Each step has a --legacy-* switch
+// that times the original OpenCV calls instead: flip, resize, tint and
+// scanline drawing for the single-pass FrameConditioner; cvtColor + inRange
+// for the fused bgrToMask; a byte mask with cv::erode / dilate for the packed
+// BitMask morphology; findContours + contourArea for BlobExtractor.
+inline int runReplay(const ReplayOptions& opt, const DetectorConfig& cfg) {
+    enum { DECODE, FLIP, RESIZE, SHADE, CONDITION, CVTCOLOR, INRANGE, BGRTOMASK, MORPH, CONTOURS, BLOBS, SELECT, TOTAL };
+    BenchReport report({"decode", "flip", "resize", "shade", "condition", "cvtColor", "inRange", "bgrToMask",
+                        "morphology", "findContours", "blobs", "select", "total"});
+
+    FrameSource source(opt.sources);
+    cv::Mat element = cv::getStructuringElement(cv::MORPH_ELLIPSE, cv::Size(5, 5));
+    cv::Mat raw, frame, display, hsv, mask, unpacked, unmorphed, check, checkFrame, checkDisplay;
+    BitMask bits, opened;
+    BitMorphology morph;
+    FrameConditioner condition(cfg.condition);
+    BlobExtractor extractor;
+    std::vector<std::vector<cv::Point>> contours;
+    const double toMs = 1000.0 / cv::getTickFrequency();
+    int frames = 0, detections = 0;
+    long long mismatchedPixels = 0, conditionMismatches = 0, blobMismatches = 0, maskMismatches = 0;
+    RoiTracker tracker;
+    double searchedPixels = 0, framePixels = 0;
+
+    while (opt.maxFrames <= 0 || frames < opt.maxFrames) {
+        int64_t t0 = cv::getTickCount();
+        if (!source.read(raw)) break;
+        int64_t t1 = cv::getTickCount();
+        report.add(DECODE, (t1 - t0) * toMs);
+
+        int64_t t = t1, start = t1, skipped = 0;
+        auto lap = [&](int stage) {
+            int64_t now = cv::getTickCount();
+            report.add(stage, (now - t) * toMs);
+            t = now;
+        };
+        auto untimed = [&]() {   // keeps the checks out of the timings
+            int64_t now = cv::getTickCount();
+            skipped += now - t;
+            t = now;
+        };
+
+        if (opt.legacyCondition) {
+            if (cfg.condition.mirror) cv::flip(raw, frame, 1);
+            else raw.copyTo(frame);
+            lap(FLIP);
+            if (!cfg.condition.size.empty()) cv::resize(frame, frame, cfg.condition.size);
+            lap(RESIZE);
+            if (cfg.condition.shade) shadeLegacy(frame, cfg.condition, display);
+            lap(SHADE);
+        } else {
+            condition(raw, frame, display);
+            lap(CONDITION);
+        }
+        if (opt.verifyCondition) {
+            if (opt.legacyCondition) condition(raw, checkFrame, checkDisplay);
+            else conditionLegacy(raw, cfg.condition, checkFrame, checkDisplay);
+            cv::compare(checkFrame.reshape(1), frame.reshape(1), check, cv::CMP_NE);
+            conditionMismatches += cv::countNonZero(check);
+            if (cfg.condition.shade) {
+                cv::compare(checkDisplay.reshape(1), display.reshape(1), check, cv::CMP_NE);
+                conditionMismatches += cv::countNonZero(check);
+            }
+            untimed();
+        }
+        cv::Rect window(0, 0, frame.cols, frame.rows);
+        if (opt.roiTracking) window = tracker.searchWindow(frame.size());
+        cv::Mat view = frame(window);
+        searchedPixels += window.area();
+        framePixels += frame.total();
+
+        // The mask is packed 64 pixels per word unless --legacy-mask asks for
+        // the byte-per-pixel Mat; 'packed' / 'mask' hold the current one.
+        BitMask* packed = &bits;
+        auto maskBytes = [&]() -> const cv::Mat& {
+            if (opt.legacyMask) return mask;
+            toMat(*packed, unpacked);
+            return unpacked;
+        };
+
+        if (opt.legacyThreshold) {
+            cv::cvtColor(view, hsv, cv::COLOR_BGR2HSV);
+            lap(CVTCOLOR);
+            cv::inRange(hsv, cfg.lowerColor, cfg.upperColor, mask);
+            if (!opt.legacyMask) toBits(mask, bits);
+            lap(INRANGE);
+        } else {
+            if (opt.legacyMask) bgrToMask(view, cfg.lowerColor, cfg.upperColor, mask);
+            else bgrToMask(view, cfg.lowerColor, cfg.upperColor, bits);
+            lap(BGRTOMASK);
+        }
+        if (opt.verifyThreshold) {
+            if (opt.legacyThreshold) {
+                bgrToMask(view, cfg.lowerColor, cfg.upperColor, check);
+            } else {
+                cv::cvtColor(view, hsv, cv::COLOR_BGR2HSV);
+                cv::inRange(hsv, cfg.lowerColor, cfg.upperColor, check);
+            }
+            cv::compare(check, maskBytes(), check, cv::CMP_NE);
+            mismatchedPixels += cv::countNonZero(check);
+            untimed();
+        }
+
+        if (cfg.morphology) {
+            if (opt.verifyMask) {
+                maskBytes().copyTo(unmorphed);
+                untimed();
+            }
+            if (opt.legacyMask) {
+                cv::erode(mask, mask, element);
+                cv::dilate(mask, mask, element);
+            } else {
+                morph.openEllipse5(bits, opened);
+                packed = &opened;
+            }
+            lap(MORPH);
+            if (opt.verifyMask) {
+                if (opt.legacyMask) {
+                    toBits(unmorphed, bits);
+                    morph.openEllipse5(bits, opened);
+                    toMat(opened, check);
+                } else {
+                    cv::erode(unmorphed, check, element);
+                    cv::dilate(check, check, element);
+                }
+                cv::compare(check, maskBytes(), check, cv::CMP_NE);
+                maskMismatches += cv::countNonZero(check);
+                untimed();
+            }
+        }
+
+        cv::Rect box;
+        bool found;
+        if (opt.legacyBlobs) {
+            found = largestContour(maskBytes(), window.tl(), cfg.minArea, box, contours);
+            lap(CONTOURS);
+        } else {
+            found = opt.legacyMask ? largestBlob(mask, window.tl(), cfg.minArea, box, extractor)
+                                   : largestBlob(*packed, window.tl(), cfg.minArea, box, extractor);
+            lap(BLOBS);
+        }
+        if (opt.verifyBlobs) {
+            cv::Rect other;
+            bool otherFound = opt.legacyBlobs ? largestBlob(maskBytes(), window.tl(), cfg.minArea, other, extractor)
+                                              : largestContour(maskBytes(), window.tl(), cfg.minArea, other, contours);
+            if (found != otherFound || (found && box != other)) blobMismatches++;
+            untimed();
+        }
+        if (found) detections++;
+        if (opt.roiTracking) tracker.update(found, box);
+        lap(SELECT);
+        report.add(TOTAL, (t - start - skipped) * toMs);
+        frames++;
+    }
+
+    if (frames == 0) {
+        std::cerr << "Error: no frames could be read from the given sources." << std::endl;
+        return -1;
+    }
+
+    std::ofstream json;
+    if (!opt.reportPath.empty()) {
+        json.open(opt.reportPath);
+        if (!json) std::cerr << "Warning: could not write " << opt.reportPath << std::endl;
+    }
+    report.write(std::cout, json.is_open() ? &json : nullptr, TOTAL, frames, detections);
+    std::cout << "searched " << std::setprecision(1) << 100.0 * searchedPixels / framePixels
+              << "% of frame pixels" << std::endl;
+    if (opt.verifyCondition)
+        std::cout << "condition check: " << conditionMismatches << " mismatching frame/display bytes" << std::endl;
+    if (opt.verifyThreshold)
+        std::cout << "threshold check: " << mismatchedPixels << " mismatching mask pixels" << std::endl;
+    if (opt.verifyMask)
+        std::cout << "mask check: " << maskMismatches << " mismatching morphology pixels" << std::endl;
+    if (opt.verifyBlobs)
+        std::cout << "blob check: " << blobMismatches << " frames with a different selection" << std::endl;
+    if (mismatchedPixels != 0 || conditionMismatches != 0 || maskMismatches != 0 || blobMismatches != 0) return 1;
+    return 0;
+}
@@ -0,0 +1,341 @@
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "replay.hpp"
+#include "condition.hpp"
+#include "threshold.hpp"
+#include "bitmask.hpp"
+#include "detect.hpp"
+#include "tracker.hpp"
+#include "engage.hpp"
+
+using namespace cv;
+using namespace std;
+
+// Detector tuning against labelled recordings. Every clip is decoded and
+// conditioned once and kept in memory; candidate configurations are then
+// evaluated in parallel, one per core, each running the same
+// threshold -> morphology -> largest blob -> RoiTracker chain as main.cpp
+// plus a simulated engagement against the lock.
+//
+// sweep [options] clip [--truth file.csv] [clip [--truth file.csv] ...]
+//   --hmin/--hmax/--smin/--vmin <list>   HSV bounds (H 0..180, S/V 0..255)
+//   --area <list>                        minimum blob area, px
+//   --morph <list>                       0 = no opening, 1 = 5x5 ellipse opening
+//   --gain <list>                        proportional navigation constant
+//   --random <n> [--seed <s>]            n random samples inside the list ranges instead of the grid
+//   --frames <n>                         stop loading after n frames in total
+//   --fps <f>                            clip frame rate for the engagement simulation (30)
+//   --csv <file>                         every result as CSV
+//   --top <n>                            rows printed, best F1 first (20)
+// A list is comma separated: --area 200,400,500. The ground truth of a clip
+// defaults to <clip>.csv, one "frame,x,y,w,h" line per labelled frame in the
+// clip's own coordinates; frames without a line have no target.
+
+struct Candidate {
+    int hmin = 100, hmax = 140, smin = 150, vmin = 0;
+    double minArea = 400;
+    bool morph = false;
+    float gain = 4;
+};
+
+struct Result {
+    long long frames = 0, truthFrames = 0, detections = 0, truePositives = 0;
+    long long lockedOn = 0, lockBreaks = 0, launches = 0, hits = 0;
+    double ms = 0;      // detection time
+
+    double precision() const { return detections ? (double)truePositives / detections : 0; }
+    double recall() const { return truthFrames ? (double)truePositives / truthFrames : 0; }
+    double f1() const {
+        double p = precision(), r = recall();
+        return p + r > 0 ? 2 * p * r / (p + r) : 0;
+    }
+    double lockRate() const { return truthFrames ? (double)lockedOn / truthFrames : 0; }
+    double msPerFrame() const { return frames ? ms / frames : 0; }
+};
+
+struct Clip {
+    string name;
+    vector<Mat> frames;     // conditioned, as the detector sees them
+    vector<Rect> truth;     // per frame, empty = no target
+};
+
+static double iou(const Rect& a, const Rect& b) {
+    double inter = (a & b).area();
+    return inter > 0 ? inter / (a.area() + b.area() - inter) : 0;
+}
+
+static vector<double> parseList(const string& s) {
+    vector<double> v;
+    stringstream ss(s);
+    string item;
+    while (getline(ss, item, ',')) v.push_back(stod(item));
+    return v;
+}
+
+// frame,x,y,w,h per line; '#' starts a comment
+static bool loadTruth(const string& path, vector<Rect>& boxes, vector<int>& frames) {
+    ifstream in(path);
+    if (!in) return false;
+    string line;
+    while (getline(in, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        replace(line.begin(), line.end(), ',', ' ');
+        stringstream ss(line);
+        int f;
+        Rect r;
+        if (ss >> f >> r.x >> r.y >> r.width >> r.height) {
+            frames.push_back(f);
+            boxes.push_back(r);
+        }
+    }
+    return true;
+}
+
+// Labels are in the recording's coordinates; the detector sees the
+// conditioned frame, so they go through the same scale and mirror.
+static Rect conditionBox(Rect r, Size raw, const ConditionConfig& cc) {
+    Size size = cc.size.empty() ? raw : cc.size;
+    double sx = (double)size.width / raw.width, sy = (double)size.height / raw.height;
+    if (cc.mirror) r.x = raw.width - r.x - r.width;
+    return Rect(cvRound(r.x * sx), cvRound(r.y * sy), cvRound(r.width * sx), cvRound(r.height * sy));
+}
+
+static bool loadClip(const string& source, const string& truthPath, const ConditionConfig& cc, int maxFrames, Clip& clip) {
+    vector<Rect> boxes;
+    vector<int> labelled;
+    if (!loadTruth(truthPath, boxes, labelled)) {
+        cerr << "Error: could not read ground truth " << truthPath << endl;
+        return false;
+    }
+    clip.name = source;
+    FrameSource in({source});
+    FrameConditioner condition(cc);
+    Mat raw, display;
+    Size rawSize;
+    while ((maxFrames <= 0 || (int)clip.frames.size() < maxFrames) && in.read(raw)) {
+        rawSize = raw.size();
+        clip.frames.emplace_back();
+        condition(raw, clip.frames.back(), display);
+    }
+    clip.truth.assign(clip.frames.size(), Rect());
+    for (size_t i = 0; i < boxes.size(); i++)
+        if (labelled[i] >= 0 && labelled[i] < (int)clip.truth.size())
+            clip.truth[labelled[i]] = conditionBox(boxes[i], rawSize, cc);
+    return !clip.frames.empty();
+}
+
+static void evaluate(const vector<Clip>& clips, const Candidate& c, double fps, Result& r) {
+    Scalar lower(c.hmin, c.smin, c.vmin), upper(c.hmax, 255, 255);
+    BitMask mask, opened;
+    BitMorphology morph;
+    BlobExtractor blobs;
+    const double toMs = 1000.0 / getTickFrequency();
+
+    for (const Clip& clip : clips) {
+        RoiTracker tracker;
+        Size size = clip.frames[0].size();
+        EngagementConfig ec;
+        ec.navGain = c.gain;
+        ec.launchers.push_back(Point2f(size.width / 2.f, (float)size.height));
+        ec.capacity = 16;
+        EngagementEngine engine(ec);
+        bool wasLocked = false;
+
+        for (size_t i = 0; i < clip.frames.size(); i++) {
+            const Mat& frame = clip.frames[i];
+            int64 t0 = getTickCount();
+            Rect window = tracker.searchWindow(size);
+            bgrToMask(frame(window), lower, upper, mask);
+            if (c.morph) morph.openEllipse5(mask, opened);
+            Rect box;
+            bool found = largestBlob(c.morph ? opened : mask, window.tl(), c.minArea, box, blobs);
+            tracker.update(found, box);
+            r.ms += (getTickCount() - t0) * toMs;
+            r.frames++;
+
+            const Rect& truth = clip.truth[i];
+            bool target = !truth.empty();
+            r.truthFrames += target;
+            r.detections += found;
+            r.truePositives += found && target && iou(box, truth) >= 0.5;
+            bool locked = tracker.locked();
+            r.lockedOn += locked && target && iou(tracker.box(), truth) >= 0.3;
+            r.lockBreaks += wasLocked && !locked && target;
+            wasLocked = locked;
+
+            // One interceptor at a time against the lock; a hit only counts
+            // when it lands on the labelled target, not just the tracked one.
+            if (locked) {
+                engine.observe(0, Point2f(tracker.center()));
+                if (engine.interceptors().size() == 0 && engine.launch(0) >= 0) r.launches++;
+            }
+            engine.advance(1.0 / fps);
+            for (const EngageEvent& e : engine.events()) {
+                if (e.type != EngageEvent::HIT || !target) continue;
+                Point2f centre(truth.x + truth.width / 2.f, truth.y + truth.height / 2.f);
+                float reach = ec.killRadius + max(truth.width, truth.height) / 2.f;
+                r.hits += norm(e.pos - centre) <= reach;
+            }
+            engine.clearEvents();
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    vector<double> hmin{100}, hmax{140}, smin{150}, vmin{0}, area{400}, morphs{0}, gain{4};
+    vector<string> sources, truths;
+    int randomCount = 0, maxFrames = 0, top = 20;
+    uint64_t seed = 1;
+    double fps = 30;
+    string csvPath;
+
+    for (int i = 1; i < argc; i++) {
+        string a = argv[i];
+        bool more = i + 1 < argc;
+        if (a == "--hmin" && more) hmin = parseList(argv[++i]);
+        else if (a == "--hmax" && more) hmax = parseList(argv[++i]);
+        else if (a == "--smin" && more) smin = parseList(argv[++i]);
+        else if (a == "--vmin" && more) vmin = parseList(argv[++i]);
+        else if (a == "--area" && more) area = parseList(argv[++i]);
+        else if (a == "--morph" && more) morphs = parseList(argv[++i]);
+        else if (a == "--gain" && more) gain = parseList(argv[++i]);
+        else if (a == "--random" && more) randomCount = stoi(argv[++i]);
+        else if (a == "--seed" && more) seed = stoull(argv[++i]);
+        else if (a == "--frames" && more) maxFrames = stoi(argv[++i]);
+        else if (a == "--fps" && more) fps = stod(argv[++i]);
+        else if (a == "--csv" && more) csvPath = argv[++i];
+        else if (a == "--top" && more) top = stoi(argv[++i]);
+        else if (a == "--truth" && more && !truths.empty()) truths.back() = argv[++i];
+        else {
+            sources.push_back(a);
+            truths.push_back(a + ".csv");
+        }
+    }
+    for (const vector<double>* v : {&hmin, &hmax, &smin, &vmin, &area, &morphs, &gain}) {
+        if (v->empty()) {
+            cerr << "Error: empty parameter list." << endl;
+            return -1;
+        }
+    }
+    if (sources.empty()) {
+        cerr << "Usage: sweep [--hmin l] [--hmax l] [--smin l] [--vmin l] [--area l] [--morph l] [--gain l]\n"
+                "             [--random n] [--seed s] [--frames n] [--fps f] [--csv file] [--top n]\n"
+                "             clip [--truth file.csv] ..." << endl;
+        return -1;
+    }
+
+    // Decode and condition every clip once; all candidates share the frames
+    ConditionConfig cc;
+    cc.size = Size(1024, 600);
+    cc.shade = false;
+    vector<Clip> clips;
+    int loaded = 0;
+    for (size_t i = 0; i < sources.size(); i++) {
+        if (maxFrames > 0 && loaded >= maxFrames) break;
+        Clip clip;
+        if (!loadClip(sources[i], truths[i], cc, maxFrames > 0 ? maxFrames - loaded : 0, clip)) continue;
+        loaded += (int)clip.frames.size();
+        clips.push_back(std::move(clip));
+    }
+    if (clips.empty()) {
+        cerr << "Error: no labelled clip could be loaded." << endl;
+        return -1;
+    }
+
+    vector<Candidate> candidates;
+    if (randomCount > 0) {
+        // Uniform inside the range each list spans
+        RNG rng(seed);
+        auto pick = [&](const vector<double>& v) {
+            auto mm = minmax_element(v.begin(), v.end());
+            return *mm.first + rng.uniform(0.0, 1.0) * (*mm.second - *mm.first);
+        };
+        for (int k = 0; k < randomCount; k++) {
+            Candidate c;
+            c.hmin = cvRound(pick(hmin));
+            c.hmax = cvRound(pick(hmax));
+            c.smin = cvRound(pick(smin));
+            c.vmin = cvRound(pick(vmin));
+            c.minArea = cvRound(pick(area));
+            c.morph = morphs[rng.uniform(0, (int)morphs.size())] != 0;
+            c.gain = (float)pick(gain);
+            candidates.push_back(c);
+        }
+    } else {
+        for (double h0 : hmin) for (double h1 : hmax) for (double s : smin) for (double v : vmin)
+            for (double a : area) for (double m : morphs) for (double g : gain) {
+                Candidate c;
+                c.hmin = (int)h0; c.hmax = (int)h1; c.smin = (int)s; c.vmin = (int)v;
+                c.minArea = a; c.morph = m != 0; c.gain = (float)g;
+                candidates.push_back(c);
+            }
+    }
+    cout << "frames: " << loaded << " in " << clips.size() << " clip(s), candidates: " << candidates.size()
+         << ", threads: " << getNumThreads() << endl;
+
+    // One candidate per task; OpenCV runs any parallel_for_ nested in here
+    // serially, so each candidate is single-threaded and the cores are
+    // shared across candidates. ms/frame is therefore measured under load.
+    vector<Result> results(candidates.size());
+    parallel_for_(Range(0, (int)candidates.size()), [&](const Range& range) {
+        for (int k = range.start; k < range.end; k++) evaluate(clips, candidates[k], fps, results[k]);
+    }, (double)candidates.size());
+
+    // Best F1 first, cheaper first on ties; '*' marks the F1 / cost Pareto front
+    vector<int> order(candidates.size());
+    for (size_t k = 0; k < order.size(); k++) order[k] = (int)k;
+    sort(order.begin(), order.end(), [&](int a, int b) {
+        if (results[a].f1() != results[b].f1()) return results[a].f1() > results[b].f1();
+        return results[a].msPerFrame() < results[b].msPerFrame();
+    });
+    vector<bool> pareto(candidates.size(), false);
+    double cheapest = 1e300;
+    for (int k : order) {
+        if (results[k].msPerFrame() < cheapest) {
+            pareto[k] = true;
+            cheapest = results[k].msPerFrame();
+        }
+    }
+
+    cout << fixed << setprecision(3);
+    cout << "  hmin hmax smin vmin  area morph gain   prec  recall     f1   lock breaks  hit/launch  ms/frame\n";
+    for (int n = 0; n < (int)order.size() && n < top; n++) {
+        const Candidate& c = candidates[order[n]];
+        const Result& r = results[order[n]];
+        cout << (pareto[order[n]] ? "*" : " ")
+             << setw(5) << c.hmin << setw(5) << c.hmax << setw(5) << c.smin << setw(5) << c.vmin
+             << setw(6) << (int)c.minArea << setw(6) << (c.morph ? "yes" : "no")
+             << setw(5) << setprecision(1) << c.gain << setprecision(3)
+             << setw(7) << r.precision() << setw(8) << r.recall() << setw(7) << r.f1()
+             << setw(7) << r.lockRate() << setw(7) << r.lockBreaks
+             << setw(6) << r.hits << "/" << left << setw(5) << r.launches << right
+             << setw(10) << r.msPerFrame() << "\n";
+    }
+
+    if (!csvPath.empty()) {
+        ofstream csv(csvPath);
+        if (!csv) {
+            cerr << "Warning: could not write " << csvPath << endl;
+        } else {
+            csv << fixed << setprecision(4);
+            csv << "hmin,hmax,smin,vmin,min_area,morph,gain,precision,recall,f1,lock_rate,lock_breaks,"
+                   "launches,hits,ms_per_frame,pareto\n";
+            for (int k : order) {
+                const Candidate& c = candidates[k];
+                const Result& r = results[k];
+                csv << c.hmin << "," << c.hmax << "," << c.smin << "," << c.vmin << "," << c.minArea << ","
+                    << c.morph << "," << c.gain << "," << r.precision() << "," << r.recall() << "," << r.f1() << ","
+                    << r.lockRate() << "," << r.lockBreaks << "," << r.launches << "," << r.hits << ","
+                    << r.msPerFrame() << "," << pareto[k] << "\n";
+            }
+        }
+    }
+    return 0;
+}
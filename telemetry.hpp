@@ -0,0 +1,364 @@
+#pragma once
+
+// Hot-path telemetry: per-stage latency histograms and event counters.
+// Every thread records into a block of its own with relaxed atomic stores
+// (one writer per block, so no locked instructions and no contention); a
+// reader sums the blocks into a TelemetrySnapshot whenever it wants figures.
+// Blocks sit in a fixed table that only grows, so readers walk it without a
+// lock and never stall a thread that is recording.
+// Latencies go into log-linear buckets, 8 per power of two (12.5 % wide), so
+// percentiles come out of the histogram without keeping samples.
+//
+// The instrumentation points are macros: ADS_TIME_STAGE(stage) for a scope,
+// ADS_LAPS / ADS_LAP for consecutive stages, ADS_COUNT(counter, n). Building
+// with ADS_NO_TELEMETRY turns them into nothing; the snapshot and writer
+// types stay, and report zeros.
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef ADS_NO_TELEMETRY
+#define ADS_TELEMETRY 1
+#endif
+
+enum class TelemetryStage { CAPTURE, CONDITION, THRESHOLD, MORPHOLOGY, BLOBS, TRACKING, HUD, IMSHOW, FRAME, COUNT };
+enum class TelemetryCounter { FRAMES, CAPTURE_DROPPED, DETECT_DROPPED, TILES, TILES_SKIPPED, COUNT };
+
+inline const char* telemetryName(TelemetryStage s) {
+    static const char* names[] = {"capture", "condition", "threshold", "morphology", "blobs",
+                                  "tracking", "hud", "imshow", "frame"};
+    return names[(int)s];
+}
+
+inline const char* telemetryName(TelemetryCounter c) {
+    static const char* names[] = {"frames", "capture_dropped", "detect_dropped", "tiles", "tiles_skipped"};
+    return names[(int)c];
+}
+
+const int TELEMETRY_STAGES = (int)TelemetryStage::COUNT;
+const int TELEMETRY_COUNTERS = (int)TelemetryCounter::COUNT;
+const int TELEMETRY_BUCKETS = 256;
+
+// Bucket of a latency in ns: values below 8 us map to themselves in 1 us
+// steps, above that 8 buckets per doubling.
+inline int telemetryBucket(uint64_t ns) {
+    uint64_t v = ns >> 10;
+    if (v < 8) return (int)v;
+    int e = 63 - __builtin_clzll(v);
+    return std::min(TELEMETRY_BUCKETS - 1, 8 * (e - 2) + (int)((v >> (e - 3)) & 7));
+}
+
+// Upper edge of bucket b in ms.
+inline double telemetryBucketMs(int b) {
+    uint64_t v = b < 8 ? b + 1 : (uint64_t)(8 + b % 8 + 1) << (b / 8 - 1);
+    return (v << 10) / 1e6;
+}
+
+struct TelemetryStats {
+    uint64_t count = 0;
+    double meanMs = 0, p50Ms = 0, p99Ms = 0, maxMs = 0;
+};
+
+// Sums over every thread's block. Two snapshots give the figures of the
+// interval between them (see TelemetryWindow).
+struct TelemetrySnapshot {
+    double seconds = 0;     // steady clock
+    uint64_t hist[TELEMETRY_STAGES][TELEMETRY_BUCKETS] = {};
+    uint64_t count[TELEMETRY_STAGES] = {};
+    uint64_t sumNs[TELEMETRY_STAGES] = {};
+    uint64_t counters[TELEMETRY_COUNTERS] = {};
+};
+
+class Telemetry {
+public:
+#ifdef ADS_TELEMETRY
+    static void record(TelemetryStage s, uint64_t ns) {
+        Block& b = local();
+        int i = (int)s;
+        bump(b.hist[i][telemetryBucket(ns)], 1);
+        bump(b.count[i], 1);
+        bump(b.sumNs[i], ns);
+    }
+
+    static void add(TelemetryCounter c, uint64_t n) { bump(local().counters[(int)c], n); }
+#endif
+
+    static void snapshot(TelemetrySnapshot& out) {
+        // cleared in place: the snapshot is ~18 KB
+        for (auto& h : out.hist) std::fill(std::begin(h), std::end(h), 0);
+        std::fill(std::begin(out.count), std::end(out.count), 0);
+        std::fill(std::begin(out.sumNs), std::end(out.sumNs), 0);
+        std::fill(std::begin(out.counters), std::end(out.counters), 0);
+        out.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#ifdef ADS_TELEMETRY
+        Registry& r = registry();
+        int n = r.size.load(std::memory_order_acquire);
+        for (int i = 0; i < n; i++) {
+            const Block* b = r.blocks[i].get();
+            for (int s = 0; s < TELEMETRY_STAGES; s++) {
+                for (int k = 0; k < TELEMETRY_BUCKETS; k++) out.hist[s][k] += b->hist[s][k].load(std::memory_order_relaxed);
+                out.count[s] += b->count[s].load(std::memory_order_relaxed);
+                out.sumNs[s] += b->sumNs[s].load(std::memory_order_relaxed);
+            }
+            for (int c = 0; c < TELEMETRY_COUNTERS; c++) out.counters[c] += b->counters[c].load(std::memory_order_relaxed);
+        }
+#endif
+    }
+
+    static uint64_t nowNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+#ifdef ADS_TELEMETRY
+private:
+    struct Block {
+        std::atomic<uint64_t> hist[TELEMETRY_STAGES][TELEMETRY_BUCKETS] = {};
+        std::atomic<uint64_t> count[TELEMETRY_STAGES] = {};
+        std::atomic<uint64_t> sumNs[TELEMETRY_STAGES] = {};
+        std::atomic<uint64_t> counters[TELEMETRY_COUNTERS] = {};
+    };
+
+    // Threads past MAX_BLOCKS share the last block, and their figures may
+    // lose the odd update
+    static const int MAX_BLOCKS = 128;
+
+    struct Registry {
+        std::mutex m;                                   // serializes registration only
+        std::unique_ptr<Block> blocks[MAX_BLOCKS];      // kept after their thread exits
+        std::atomic<int> size{0};                       // published after the block is built
+    };
+
+    // Only the owning thread writes, so a plain load + store is enough
+    static void bump(std::atomic<uint64_t>& a, uint64_t n) {
+        a.store(a.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    static Registry& registry() {
+        static Registry r;
+        return r;
+    }
+
+    // The first record on a thread registers its block (one allocation)
+    static Block& local() {
+        thread_local Block* block = nullptr;
+        if (!block) {
+            Registry& r = registry();
+            std::lock_guard<std::mutex> lock(r.m);
+            int n = r.size.load(std::memory_order_relaxed);
+            if (n == MAX_BLOCKS) {
+                block = r.blocks[n - 1].get();
+            } else {
+                r.blocks[n].reset(new Block());
+                block = r.blocks[n].get();
+                r.size.store(n + 1, std::memory_order_release);
+            }
+        }
+        return *block;
+    }
+#endif
+};
+
+// Records the lifetime of a scope.
+class StageTimer {
+public:
+    explicit StageTimer(TelemetryStage s) : stage_(s), start_(Telemetry::nowNs()) {}
+#ifdef ADS_TELEMETRY
+    ~StageTimer() { Telemetry::record(stage_, Telemetry::nowNs() - start_); }
+#endif
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+
+private:
+    TelemetryStage stage_;
+    uint64_t start_;
+};
+
+// Consecutive stages inside one scope: lap(s) charges the time since the
+// previous lap to s. Laps of the same stage add up (a stage run once per
+// search window counts once per frame); the sums are recorded at the end of
+// the scope.
+class StageLaps {
+public:
+    StageLaps() : last_(Telemetry::nowNs()) {}
+#ifdef ADS_TELEMETRY
+    ~StageLaps() {
+        for (int i = 0; i < TELEMETRY_STAGES; i++)
+            if (used_ & (1u << i)) Telemetry::record((TelemetryStage)i, sum_[i]);
+    }
+#endif
+    StageLaps(const StageLaps&) = delete;
+    StageLaps& operator=(const StageLaps&) = delete;
+
+    void lap(TelemetryStage s) {
+        uint64_t now = Telemetry::nowNs();
+        sum_[(int)s] += now - last_;
+        used_ |= 1u << (int)s;
+        last_ = now;
+    }
+
+private:
+    uint64_t last_;
+    uint64_t sum_[TELEMETRY_STAGES] = {};
+    unsigned used_ = 0;
+};
+
+#ifdef ADS_TELEMETRY
+#define ADS_TELEMETRY_CAT2(a, b) a##b
+#define ADS_TELEMETRY_CAT(a, b) ADS_TELEMETRY_CAT2(a, b)
+#define ADS_TIME_STAGE(stage) StageTimer ADS_TELEMETRY_CAT(adsStageTimer, __LINE__)(TelemetryStage::stage)
+#define ADS_LAPS(name) StageLaps name
+#define ADS_LAP(name, stage) name.lap(TelemetryStage::stage)
+#define ADS_COUNT(counter, n) Telemetry::add(TelemetryCounter::counter, (n))
+#else
+#define ADS_TIME_STAGE(stage) ((void)0)
+#define ADS_LAPS(name) ((void)0)
+#define ADS_LAP(name, stage) ((void)0)
+#define ADS_COUNT(counter, n) ((void)0)
+#endif
+
+// Figures over the interval between the last two update() calls. The two
+// snapshots swap roles, so an update reads the blocks once and copies nothing.
+class TelemetryWindow {
+public:
+    TelemetryWindow() {
+        Telemetry::snapshot(snaps_[0]);
+        snaps_[1] = snaps_[0];
+    }
+
+    void update() {
+        cur_ = 1 - cur_;
+        Telemetry::snapshot(snaps_[cur_]);
+    }
+
+    double seconds() const { return cur().seconds - prev().seconds; }
+    uint64_t counter(TelemetryCounter c) const { return cur().counters[(int)c] - prev().counters[(int)c]; }
+    double rate(TelemetryCounter c) const { return seconds() > 0 ? counter(c) / seconds() : 0; }
+
+    TelemetryStats stage(TelemetryStage s) const {
+        int i = (int)s;
+        TelemetryStats st;
+        st.count = cur().count[i] - prev().count[i];
+        if (!st.count) return st;
+        st.meanMs = (cur().sumNs[i] - prev().sumNs[i]) / 1e6 / st.count;
+        uint64_t seen = 0, p50 = (st.count + 1) / 2, p99 = st.count - st.count / 100;
+        for (int k = 0; k < TELEMETRY_BUCKETS; k++) {
+            uint64_t n = cur().hist[i][k] - prev().hist[i][k];
+            if (!n) continue;
+            if (seen < p50 && seen + n >= p50) st.p50Ms = telemetryBucketMs(k);
+            if (seen < p99 && seen + n >= p99) st.p99Ms = telemetryBucketMs(k);
+            seen += n;
+            st.maxMs = telemetryBucketMs(k);
+        }
+        return st;
+    }
+
+private:
+    const TelemetrySnapshot& cur() const { return snaps_[cur_]; }
+    const TelemetrySnapshot& prev() const { return snaps_[1 - cur_]; }
+
+    TelemetrySnapshot snaps_[2];
+    int cur_ = 0;
+};
+
+// Appends the figures of every period to a file from a background thread:
+// one CSV row per period for a .csv path, otherwise one JSON object per line.
+class TelemetryWriter {
+public:
+    TelemetryWriter(const std::string& path, std::chrono::milliseconds period = std::chrono::seconds(1))
+        : period_(period) {
+#ifdef ADS_TELEMETRY
+        if (path.empty()) return;
+        file_ = std::fopen(path.c_str(), "w");
+        if (!file_) {
+            std::fprintf(stderr, "Warning: could not write %s\n", path.c_str());
+            return;
+        }
+        csv_ = path.size() >= 4 && path.compare(path.size() - 4, 4, ".csv") == 0;
+        if (csv_) header();
+        thread_ = std::thread([this] { run(); });
+#else
+        (void)path;
+#endif
+    }
+
+    ~TelemetryWriter() {
+        {
+            std::lock_guard<std::mutex> lock(m_);
+            stop_ = true;
+        }
+        cv_.notify_one();
+        if (thread_.joinable()) thread_.join();
+        if (file_) std::fclose(file_);
+    }
+
+private:
+    void run() {
+        std::unique_lock<std::mutex> lock(m_);
+        while (!cv_.wait_for(lock, period_, [this] { return stop_; })) {
+            window_.update();
+            csv_ ? row() : object();
+            std::fflush(file_);
+        }
+    }
+
+    void header() {
+        std::fprintf(file_, "time_s,fps");
+        for (int c = 0; c < TELEMETRY_COUNTERS; c++) std::fprintf(file_, ",%s", telemetryName((TelemetryCounter)c));
+        for (int s = 0; s < TELEMETRY_STAGES; s++) {
+            const char* n = telemetryName((TelemetryStage)s);
+            std::fprintf(file_, ",%s_count,%s_mean_ms,%s_p50_ms,%s_p99_ms,%s_max_ms", n, n, n, n, n);
+        }
+        std::fprintf(file_, "\n");
+    }
+
+    void row() {
+        std::fprintf(file_, "%.3f,%.2f", elapsed(), window_.rate(TelemetryCounter::FRAMES));
+        for (int c = 0; c < TELEMETRY_COUNTERS; c++)
+            std::fprintf(file_, ",%llu", (unsigned long long)window_.counter((TelemetryCounter)c));
+        for (int s = 0; s < TELEMETRY_STAGES; s++) {
+            TelemetryStats st = window_.stage((TelemetryStage)s);
+            std::fprintf(file_, ",%llu,%.4f,%.4f,%.4f,%.4f", (unsigned long long)st.count, st.meanMs, st.p50Ms,
+                         st.p99Ms, st.maxMs);
+        }
+        std::fprintf(file_, "\n");
+    }
+
+    void object() {
+        std::fprintf(file_, "{\"time_s\": %.3f, \"fps\": %.2f", elapsed(), window_.rate(TelemetryCounter::FRAMES));
+        for (int c = 0; c < TELEMETRY_COUNTERS; c++)
+            std::fprintf(file_, ", \"%s\": %llu", telemetryName((TelemetryCounter)c),
+                         (unsigned long long)window_.counter((TelemetryCounter)c));
+        std::fprintf(file_, ", \"stages\": {");
+        for (int s = 0; s < TELEMETRY_STAGES; s++) {
+            TelemetryStats st = window_.stage((TelemetryStage)s);
+            std::fprintf(file_, "%s\"%s\": {\"count\": %llu, \"mean_ms\": %.4f, \"p50_ms\": %.4f, \"p99_ms\": %.4f, \"max_ms\": %.4f}",
+                         s ? ", " : "", telemetryName((TelemetryStage)s), (unsigned long long)st.count, st.meanMs,
+                         st.p50Ms, st.p99Ms, st.maxMs);
+        }
+        std::fprintf(file_, "}}\n");
+    }
+
+    double elapsed() const { return std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count(); }
+
+    std::chrono::milliseconds period_;
+    std::chrono::steady_clock::time_point start_ = std::chrono::steady_clock::now();
+    std::FILE* file_ = nullptr;
+    bool csv_ = false;
+    TelemetryWindow window_;
+    std::mutex m_;
+    std::condition_variable cv_;
+    bool stop_ = false;
+    std::thread thread_;
+};
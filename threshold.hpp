@@ -0,0 +1,251 @@
+#pragma once
+
+// Fused BGR -> binary mask threshold. Produces exactly what
+//     cvtColor(bgr, hsv, COLOR_BGR2HSV); inRange(hsv, lower, upper, mask);
+// produces, but in one pass and without the 3-channel HSV scratch image.
+// The HSV math mirrors OpenCV's fixed-point RGB2HSV_b (hsv_shift = 12,
+// hue range 0..180) so the result is bit-exact.
+
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <cmath>
+#include "bitmask.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ADS_X86_SIMD 1
+#endif
+
+struct HsvTables {
+    int sdiv[256];
+    int hdiv[256];
+};
+
+inline const HsvTables& hsvTables() {
+    static const HsvTables t = [] {
+        HsvTables t;
+        t.sdiv[0] = t.hdiv[0] = 0;
+        for (int i = 1; i < 256; i++) {
+            t.sdiv[i] = cv::saturate_cast<int>((255 << 12) / (1. * i));
+            t.hdiv[i] = cv::saturate_cast<int>((180 << 12) / (6. * i));
+        }
+        return t;
+    }();
+    return t;
+}
+
+// inRange bounds converted the way inRange converts them for 8-bit input.
+struct HsvBand {
+    int lo[3], hi[3];
+    bool empty = false;
+
+    HsvBand(const cv::Scalar& lower, const cv::Scalar& upper) {
+        for (int c = 0; c < 3; c++) {
+            lo[c] = std::max(0, (int)std::ceil(lower[c]));
+            hi[c] = std::min(255, (int)std::floor(upper[c]));
+            if (lo[c] > hi[c]) empty = true;
+        }
+    }
+};
+
+inline void bgrToMaskRowScalar(const uchar* src, uchar* dst, int n, const HsvBand& band) {
+    const HsvTables& t = hsvTables();
+    for (int x = 0; x < n; x++, src += 3) {
+        int b = src[0], g = src[1], r = src[2];
+        int v = std::max(b, std::max(g, r));
+        int vmin = std::min(b, std::min(g, r));
+        int diff = v - vmin;
+        int vr = v == r ? -1 : 0;
+        int vg = v == g ? -1 : 0;
+        int s = (diff * t.sdiv[v] + (1 << 11)) >> 12;
+        int h = (vr & (g - b)) + (~vr & ((vg & (b - r + 2 * diff)) + ((~vg) & (r - g + 4 * diff))));
+        h = (h * t.hdiv[diff] + (1 << 11)) >> 12;
+        h += h < 0 ? 180 : 0;
+        dst[x] = (h >= band.lo[0] && h <= band.hi[0] &&
+                  s >= band.lo[1] && s <= band.hi[1] &&
+                  v >= band.lo[2] && v <= band.hi[2]) ? 255 : 0;
+    }
+}
+
+#ifdef ADS_X86_SIMD
+
+// Splits 16 packed BGR pixels into B, G and R byte vectors.
+__attribute__((target("ssse3")))
+inline void deinterleaveBgr16(const uchar* p, __m128i& b, __m128i& g, __m128i& r) {
+    __m128i a0 = _mm_loadu_si128((const __m128i*)p);
+    __m128i a1 = _mm_loadu_si128((const __m128i*)(p + 16));
+    __m128i a2 = _mm_loadu_si128((const __m128i*)(p + 32));
+    b = _mm_or_si128(_mm_or_si128(
+            _mm_shuffle_epi8(a0, _mm_setr_epi8(0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)),
+            _mm_shuffle_epi8(a1, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14, -1, -1, -1, -1, -1))),
+            _mm_shuffle_epi8(a2, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 1, 4, 7, 10, 13)));
+    g = _mm_or_si128(_mm_or_si128(
+            _mm_shuffle_epi8(a0, _mm_setr_epi8(1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)),
+            _mm_shuffle_epi8(a1, _mm_setr_epi8(-1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1))),
+            _mm_shuffle_epi8(a2, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14)));
+    r = _mm_or_si128(_mm_or_si128(
+            _mm_shuffle_epi8(a0, _mm_setr_epi8(2, 5, 8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)),
+            _mm_shuffle_epi8(a1, _mm_setr_epi8(-1, -1, -1, -1, -1, 1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1))),
+            _mm_shuffle_epi8(a2, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15)));
+}
+
+__attribute__((target("avx2")))
+inline __m256i inside8(__m256i x, int lo, int hi) {
+    return _mm256_andnot_si256(_mm256_cmpgt_epi32(x, _mm256_set1_epi32(hi)),
+                               _mm256_cmpgt_epi32(x, _mm256_set1_epi32(lo - 1)));
+}
+
+// 8 pixels in 32-bit lanes -> 0 / -1 per lane.
+__attribute__((target("avx2")))
+inline __m256i hsvTest8(__m256i b, __m256i g, __m256i r, const HsvBand& band, const HsvTables& t) {
+    __m256i v = _mm256_max_epi32(_mm256_max_epi32(b, g), r);
+    __m256i vmin = _mm256_min_epi32(_mm256_min_epi32(b, g), r);
+    __m256i diff = _mm256_sub_epi32(v, vmin);
+    __m256i vr = _mm256_cmpeq_epi32(v, r);
+    __m256i vg = _mm256_cmpeq_epi32(v, g);
+    __m256i half = _mm256_set1_epi32(1 << 11);
+
+    __m256i s = _mm256_mullo_epi32(diff, _mm256_i32gather_epi32(t.sdiv, v, 4));
+    s = _mm256_srai_epi32(_mm256_add_epi32(s, half), 12);
+
+    __m256i d2 = _mm256_add_epi32(diff, diff);
+    __m256i hg = _mm256_add_epi32(_mm256_sub_epi32(b, r), d2);
+    __m256i hb = _mm256_add_epi32(_mm256_sub_epi32(r, g), _mm256_add_epi32(d2, d2));
+    __m256i h = _mm256_or_si256(_mm256_and_si256(vr, _mm256_sub_epi32(g, b)),
+                _mm256_andnot_si256(vr, _mm256_blendv_epi8(hb, hg, vg)));
+    h = _mm256_mullo_epi32(h, _mm256_i32gather_epi32(t.hdiv, diff, 4));
+    h = _mm256_srai_epi32(_mm256_add_epi32(h, half), 12);
+    h = _mm256_add_epi32(h, _mm256_and_si256(_mm256_cmpgt_epi32(_mm256_setzero_si256(), h), _mm256_set1_epi32(180)));
+
+    return _mm256_and_si256(_mm256_and_si256(inside8(h, band.lo[0], band.hi[0]),
+                                             inside8(s, band.lo[1], band.hi[1])),
+                            inside8(v, band.lo[2], band.hi[2]));
+}
+
+__attribute__((target("avx2")))
+inline void bgrToMaskRowAvx2(const uchar* src, uchar* dst, int n, const HsvBand& band) {
+    const HsvTables& t = hsvTables();
+    int x = 0;
+    for (; x <= n - 16; x += 16, src += 48) {
+        __m128i b, g, r;
+        deinterleaveBgr16(src, b, g, r);
+        __m256i m0 = hsvTest8(_mm256_cvtepu8_epi32(b), _mm256_cvtepu8_epi32(g), _mm256_cvtepu8_epi32(r), band, t);
+        __m256i m1 = hsvTest8(_mm256_cvtepu8_epi32(_mm_srli_si128(b, 8)),
+                              _mm256_cvtepu8_epi32(_mm_srli_si128(g, 8)),
+                              _mm256_cvtepu8_epi32(_mm_srli_si128(r, 8)), band, t);
+        __m128i w0 = _mm_packs_epi32(_mm256_castsi256_si128(m0), _mm256_extracti128_si256(m0, 1));
+        __m128i w1 = _mm_packs_epi32(_mm256_castsi256_si128(m1), _mm256_extracti128_si256(m1, 1));
+        _mm_storeu_si128((__m128i*)(dst + x), _mm_packs_epi16(w0, w1));
+    }
+    bgrToMaskRowScalar(src, dst + x, n - x, band);
+}
+
+__attribute__((target("sse4.1")))
+inline __m128i inside4(__m128i x, int lo, int hi) {
+    return _mm_andnot_si128(_mm_cmpgt_epi32(x, _mm_set1_epi32(hi)),
+                            _mm_cmpgt_epi32(x, _mm_set1_epi32(lo - 1)));
+}
+
+// 4 pixels in 32-bit lanes; SSE has no gather so the two table lookups
+// are done per lane.
+__attribute__((target("sse4.1")))
+inline __m128i hsvTest4(__m128i b, __m128i g, __m128i r, const HsvBand& band, const HsvTables& t) {
+    __m128i v = _mm_max_epi32(_mm_max_epi32(b, g), r);
+    __m128i vmin = _mm_min_epi32(_mm_min_epi32(b, g), r);
+    __m128i diff = _mm_sub_epi32(v, vmin);
+    __m128i vr = _mm_cmpeq_epi32(v, r);
+    __m128i vg = _mm_cmpeq_epi32(v, g);
+    __m128i half = _mm_set1_epi32(1 << 11);
+
+    __m128i sd = _mm_setr_epi32(t.sdiv[_mm_extract_epi32(v, 0)], t.sdiv[_mm_extract_epi32(v, 1)],
+                                t.sdiv[_mm_extract_epi32(v, 2)], t.sdiv[_mm_extract_epi32(v, 3)]);
+    __m128i hd = _mm_setr_epi32(t.hdiv[_mm_extract_epi32(diff, 0)], t.hdiv[_mm_extract_epi32(diff, 1)],
+                                t.hdiv[_mm_extract_epi32(diff, 2)], t.hdiv[_mm_extract_epi32(diff, 3)]);
+    __m128i s = _mm_srai_epi32(_mm_add_epi32(_mm_mullo_epi32(diff, sd), half), 12);
+
+    __m128i d2 = _mm_add_epi32(diff, diff);
+    __m128i hg = _mm_add_epi32(_mm_sub_epi32(b, r), d2);
+    __m128i hb = _mm_add_epi32(_mm_sub_epi32(r, g), _mm_add_epi32(d2, d2));
+    __m128i h = _mm_or_si128(_mm_and_si128(vr, _mm_sub_epi32(g, b)),
+                _mm_andnot_si128(vr, _mm_blendv_epi8(hb, hg, vg)));
+    h = _mm_srai_epi32(_mm_add_epi32(_mm_mullo_epi32(h, hd), half), 12);
+    h = _mm_add_epi32(h, _mm_and_si128(_mm_cmplt_epi32(h, _mm_setzero_si128()), _mm_set1_epi32(180)));
+
+    return _mm_and_si128(_mm_and_si128(inside4(h, band.lo[0], band.hi[0]),
+                                       inside4(s, band.lo[1], band.hi[1])),
+                         inside4(v, band.lo[2], band.hi[2]));
+}
+
+__attribute__((target("sse4.1")))
+inline void bgrToMaskRowSse41(const uchar* src, uchar* dst, int n, const HsvBand& band) {
+    const HsvTables& t = hsvTables();
+    int x = 0;
+    for (; x <= n - 16; x += 16, src += 48) {
+        __m128i b, g, r;
+        deinterleaveBgr16(src, b, g, r);
+        __m128i m[4];
+        for (int k = 0; k < 4; k++) {
+            m[k] = hsvTest4(_mm_cvtepu8_epi32(b), _mm_cvtepu8_epi32(g), _mm_cvtepu8_epi32(r), band, t);
+            b = _mm_srli_si128(b, 4);
+            g = _mm_srli_si128(g, 4);
+            r = _mm_srli_si128(r, 4);
+        }
+        _mm_storeu_si128((__m128i*)(dst + x),
+                         _mm_packs_epi16(_mm_packs_epi32(m[0], m[1]), _mm_packs_epi32(m[2], m[3])));
+    }
+    bgrToMaskRowScalar(src, dst + x, n - x, band);
+}
+
+#endif // ADS_X86_SIMD
+
+typedef void (*BgrToMaskRowFn)(const uchar*, uchar*, int, const HsvBand&);
+
+inline BgrToMaskRowFn bgrToMaskRowKernel() {
+#ifdef ADS_X86_SIMD
+    if (cv::checkHardwareSupport(CV_CPU_AVX2)) return bgrToMaskRowAvx2;
+    if (cv::checkHardwareSupport(CV_CPU_SSE4_1)) return bgrToMaskRowSse41;
+#endif
+    return bgrToMaskRowScalar;
+}
+
+// Same result as cvtColor(COLOR_BGR2HSV) + inRange(lower, upper) for an
+// 8-bit 3-channel BGR image. Rows are split into stripes across cores.
+inline void bgrToMask(const cv::Mat& bgr, const cv::Scalar& lower, const cv::Scalar& upper, cv::Mat& mask) {
+    CV_Assert(bgr.type() == CV_8UC3);
+    mask.create(bgr.rows, bgr.cols, CV_8UC1);
+    HsvBand band(lower, upper);
+    if (band.empty) {
+        mask.setTo(cv::Scalar(0));
+        return;
+    }
+    static const BgrToMaskRowFn kernel = bgrToMaskRowKernel();
+    cv::parallel_for_(cv::Range(0, bgr.rows), [&](const cv::Range& rows) {
+        for (int y = rows.start; y < rows.end; y++)
+            kernel(bgr.ptr<uchar>(y), mask.ptr<uchar>(y), bgr.cols, band);
+    }, bgr.total() / (double)(1 << 16));
+}
+
+// Same, straight into a packed mask: each row is thresholded in chunks into a
+// small byte buffer and packed, so no full-size byte mask is written.
+inline void bgrToMask(const cv::Mat& bgr, const cv::Scalar& lower, const cv::Scalar& upper, BitMask& mask) {
+    CV_Assert(bgr.type() == CV_8UC3);
+    mask.create(bgr.rows, bgr.cols);
+    HsvBand band(lower, upper);
+    if (band.empty) {
+        mask.clear();
+        return;
+    }
+    static const BgrToMaskRowFn kernel = bgrToMaskRowKernel();
+    cv::parallel_for_(cv::Range(0, bgr.rows), [&](const cv::Range& rows) {
+        uchar chunk[256];
+        for (int y = rows.start; y < rows.end; y++) {
+            const uchar* src = bgr.ptr<uchar>(y);
+            uint64_t* dst = mask.row(y);
+            for (int x = 0; x < bgr.cols; x += 256) {
+                int n = std::min(256, bgr.cols - x);
+                kernel(src + 3 * x, chunk, n, band);
+                packBits(chunk, n, dst + x / 64);
+            }
+        }
+    }, bgr.total() / (double)(1 << 16));
+}
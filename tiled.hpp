@@ -0,0 +1,94 @@
+#pragma once
+
+// Full-resolution detection in row bands. Every band is classified (or
+// thresholded) and opened on its own, while its rows are still in cache,
+// instead of streaming the whole frame and mask through memory once per
+// stage. A band carries a 4-row halo above and below, so the 5x5 opening is
+// exact across the seams. The band masks are written into one packed mask
+// per class, and BlobExtractor then labels it in parallel bands and joins
+// the blobs that cross band seams into single detections.
+
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include "bitmask.hpp"
+#include "blobs.hpp"
+#include "classify.hpp"
+#include "detect.hpp"
+#include "threshold.hpp"
+
+class TiledDetector {
+public:
+    explicit TiledDetector(int bandRows = 64) : bandRows_(bandRows) {}
+
+    // Packed masks of every class of 'classifier' over bgr, opened with the
+    // 5x5 ellipse when 'morphology' is set.
+    void mask(const cv::Mat& bgr, const ColorClassifier& classifier, bool morphology) {
+        bands(bgr, classifier.classCount(), morphology,
+              [&](const cv::Mat& rows, std::vector<BitMask>& out) { classifier.masks(rows, out); });
+    }
+
+    // The same for one HSV band.
+    void mask(const cv::Mat& bgr, const cv::Scalar& lower, const cv::Scalar& upper, bool morphology) {
+        bands(bgr, 1, morphology, [&](const cv::Mat& rows, std::vector<BitMask>& out) {
+            out.resize(1);
+            bgrToMask(rows, lower, upper, out[0]);
+        });
+    }
+
+    // Appends the box and class ID (1..) of every blob above minArea in the
+    // masks of the last mask() call; 'offset' is where bgr sits in the frame.
+    void extract(cv::Point offset, double minArea, std::vector<cv::Rect>& boxes, std::vector<int>& classes) {
+        classBlobs(masks_, offset, minArea, boxes, classes, extractor_);
+    }
+
+    void detect(const cv::Mat& bgr, cv::Point offset, const ColorClassifier& classifier, bool morphology,
+                double minArea, std::vector<cv::Rect>& boxes, std::vector<int>& classes) {
+        mask(bgr, classifier, morphology);
+        extract(offset, minArea, boxes, classes);
+    }
+
+    const std::vector<BitMask>& masks() const { return masks_; }
+
+private:
+    struct Band {
+        std::vector<BitMask> raw, opened;
+        BitMorphology morph;
+    };
+
+    template <typename Threshold>
+    void bands(const cv::Mat& bgr, int classes, bool morphology, Threshold threshold) {
+        CV_Assert(bgr.type() == CV_8UC3);
+        masks_.resize(classes);
+        for (BitMask& m : masks_) m.create(bgr.rows, bgr.cols);
+        const int halo = morphology ? 4 : 0;
+        int count = (bgr.rows + bandRows_ - 1) / bandRows_;
+        if ((int)bands_.size() < count) bands_.resize(count);
+
+        // Kernels called inside a band run serially; the bands are the parallelism
+        cv::parallel_for_(cv::Range(0, count), [&](const cv::Range& r) {
+            for (int b = r.start; b < r.end; b++) {
+                int y0 = b * bandRows_, y1 = std::min(bgr.rows, y0 + bandRows_);
+                int a0 = std::max(0, y0 - halo), a1 = std::min(bgr.rows, y1 + halo);
+                Band& band = bands_[b];
+                threshold(bgr.rowRange(a0, a1), band.raw);
+                band.opened.resize(classes);
+                for (int c = 0; c < classes; c++) {
+                    const BitMask* src = &band.raw[c];
+                    if (morphology) {
+                        band.morph.openEllipse5(band.raw[c], band.opened[c]);
+                        src = &band.opened[c];
+                    }
+                    std::memcpy(masks_[c].row(y0), src->row(y0 - a0),
+                                (size_t)(y1 - y0) * src->stride() * sizeof(uint64_t));
+                }
+            }
+        }, count);
+    }
+
+    int bandRows_;
+    std::vector<BitMask> masks_;
+    std::vector<Band> bands_;
+    BlobExtractor extractor_;
+};
@@ -0,0 +1,118 @@
+#pragma once
+
+// Predictive ROI tracking. While a target is locked, detection only runs in
+// a padded window around the Kalman prediction of the next position; after
+// maxMisses frames without a detection the lock is dropped and the search
+// goes back to the full frame.
+
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <cmath>
+
+// Constant-velocity model of a point. State (x, y, vx, vy), measurement
+// (x, y), one step per frame.
+class MotionModel {
+public:
+    MotionModel() : kf_(4, 2, 0, CV_32F), measurement_(2, 1, CV_32F) {
+        kf_.transitionMatrix = (cv::Mat_<float>(4, 4) << 1, 0, 1, 0,
+                                                         0, 1, 0, 1,
+                                                         0, 0, 1, 0,
+                                                         0, 0, 0, 1);
+        cv::setIdentity(kf_.measurementMatrix);
+        cv::setIdentity(kf_.processNoiseCov, cv::Scalar(1e-1));
+        cv::setIdentity(kf_.measurementNoiseCov, cv::Scalar(4));
+    }
+
+    void init(cv::Point2f p) {
+        kf_.statePost.at<float>(0) = p.x;
+        kf_.statePost.at<float>(1) = p.y;
+        kf_.statePost.at<float>(2) = 0;
+        kf_.statePost.at<float>(3) = 0;
+        cv::setIdentity(kf_.errorCovPost, cv::Scalar(10));
+    }
+
+    cv::Point2f predict() {
+        const cv::Mat& s = kf_.predict();
+        return cv::Point2f(s.at<float>(0), s.at<float>(1));
+    }
+
+    cv::Point2f correct(cv::Point2f p) {
+        measurement_.at<float>(0) = p.x;
+        measurement_.at<float>(1) = p.y;
+        const cv::Mat& s = kf_.correct(measurement_);
+        return cv::Point2f(s.at<float>(0), s.at<float>(1));
+    }
+
+    cv::Point2f velocity() const {
+        return cv::Point2f(kf_.statePost.at<float>(2), kf_.statePost.at<float>(3));
+    }
+
+private:
+    cv::KalmanFilter kf_;
+    cv::Mat measurement_;   // filled in place, so a correction does not allocate
+};
+
+struct RoiTrackerConfig {
+    int padding = 40;           // pixels added around the predicted box
+    float velocityPadding = 2;  // extra padding per pixel/frame of speed
+    int maxMisses = 8;          // frames to coast before the lock is dropped
+};
+
+class RoiTracker {
+public:
+    explicit RoiTracker(RoiTrackerConfig cfg = RoiTrackerConfig()) : cfg_(cfg) {}
+
+    // Window to search in the coming frame; the whole frame when nothing is
+    // being tracked.
+    cv::Rect searchWindow(cv::Size frameSize) {
+        cv::Rect full(0, 0, frameSize.width, frameSize.height);
+        if (!tracking_) return full;
+
+        predicted_ = model_.predict();
+        cv::Point2f v = model_.velocity();
+        int pad = cfg_.padding + (int)(cfg_.velocityPadding * std::hypot(v.x, v.y));
+        int w = box_.width + 2 * pad, h = box_.height + 2 * pad;
+        cv::Rect window((int)predicted_.x - w / 2, (int)predicted_.y - h / 2, w, h);
+        window &= full;
+        return window.empty() ? full : window;
+    }
+
+    // Feeds the detection result for the frame searchWindow() was called for.
+    void update(bool found, const cv::Rect& detected) {
+        if (found) {
+            cv::Point2f c(detected.x + detected.width / 2.f, detected.y + detected.height / 2.f);
+            if (!tracking_) {
+                model_.init(c);
+                tracking_ = true;
+            } else {
+                c = model_.correct(c);
+            }
+            box_ = cv::Rect((int)(c.x - detected.width / 2.f), (int)(c.y - detected.height / 2.f),
+                            detected.width, detected.height);
+            misses_ = 0;
+        } else if (tracking_) {
+            if (++misses_ > cfg_.maxMisses) {
+                tracking_ = false;
+                misses_ = 0;
+            } else {
+                // Coast on the prediction with the last known size.
+                box_.x = (int)(predicted_.x - box_.width / 2.f);
+                box_.y = (int)(predicted_.y - box_.height / 2.f);
+            }
+        }
+    }
+
+    bool locked() const { return tracking_; }
+    bool coasting() const { return tracking_ && misses_ > 0; }
+    int misses() const { return misses_; }
+    cv::Rect box() const { return box_; }
+    cv::Point center() const { return cv::Point(box_.x + box_.width / 2, box_.y + box_.height / 2); }
+
+private:
+    RoiTrackerConfig cfg_;
+    MotionModel model_;
+    bool tracking_ = false;
+    int misses_ = 0;
+    cv::Rect box_;
+    cv::Point2f predicted_;
+};
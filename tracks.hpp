@@ -0,0 +1,260 @@
+#pragma once
+
+// Multi-target track manager. Every blob above the area threshold becomes a
+// track with a stable ID that goes through
+//     TENTATIVE -> CONFIRMED <-> COASTING -> DELETED
+// Detections are associated to tracks by gated nearest neighbour; the gating
+// uses a uniform grid of detection centres so association stays close to
+// linear in the number of blobs.
+
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "tracker.hpp"
+
+enum class TrackState { TENTATIVE, CONFIRMED, COASTING, DELETED };
+
+struct Track {
+    int id = 0;
+    TrackState state = TrackState::TENTATIVE;
+    cv::Rect box;
+    cv::Point2f predicted;
+    int hits = 0;       // total frames with a detection
+    int misses = 0;     // consecutive frames without one
+    int cls = 0;        // colour class ID (classify.hpp), 0 when unclassified
+
+    bool visible() const { return state == TrackState::CONFIRMED || state == TrackState::COASTING; }
+    cv::Point center() const { return cv::Point(box.x + box.width / 2, box.y + box.height / 2); }
+};
+
+struct TrackManagerConfig {
+    float gate = 60;              // max centre distance for an association, px
+    int confirmHits = 3;          // hits before a tentative track is shown
+    int tentativeMisses = 1;      // misses that kill a tentative track
+    int maxMisses = 8;            // coasting frames before a track is deleted
+    int padding = 40;             // search window margin around predictions
+    int fullSearchInterval = 10;  // frames between full-frame searches for new targets
+};
+
+// Uniform grid over detection centres, rebuilt every frame with a counting
+// sort (CSR layout: cellStart_ / items_).
+class SpatialGrid {
+public:
+    void build(const std::vector<cv::Point2f>& points, cv::Size area, float cellSize) {
+        cell_ = std::max(cellSize, 1.f);
+        cols_ = std::max(1, (int)std::ceil(area.width / cell_));
+        rows_ = std::max(1, (int)std::ceil(area.height / cell_));
+        cellStart_.assign(cols_ * rows_ + 1, 0);
+        cellOf_.resize(points.size());
+        for (size_t i = 0; i < points.size(); i++) {
+            cellOf_[i] = cellIndex(points[i]);
+            cellStart_[cellOf_[i] + 1]++;
+        }
+        for (int c = 0; c < cols_ * rows_; c++) cellStart_[c + 1] += cellStart_[c];
+        items_.resize(points.size());
+        fill_.assign(cellStart_.begin(), cellStart_.end() - 1);
+        for (size_t i = 0; i < points.size(); i++) items_[fill_[cellOf_[i]]++] = (int)i;
+    }
+
+    // Calls f(index) for every point in the 3x3 cells around p.
+    template <typename F>
+    void forNeighbours(cv::Point2f p, F f) const {
+        int cx = std::clamp((int)(p.x / cell_), 0, cols_ - 1);
+        int cy = std::clamp((int)(p.y / cell_), 0, rows_ - 1);
+        for (int y = std::max(cy - 1, 0); y <= std::min(cy + 1, rows_ - 1); y++)
+            for (int x = std::max(cx - 1, 0); x <= std::min(cx + 1, cols_ - 1); x++)
+                for (int k = cellStart_[y * cols_ + x]; k < cellStart_[y * cols_ + x + 1]; k++)
+                    f(items_[k]);
+    }
+
+private:
+    int cellIndex(cv::Point2f p) const {
+        int cx = std::clamp((int)(p.x / cell_), 0, cols_ - 1);
+        int cy = std::clamp((int)(p.y / cell_), 0, rows_ - 1);
+        return cy * cols_ + cx;
+    }
+
+    float cell_ = 1;
+    int cols_ = 1, rows_ = 1;
+    std::vector<int> cellStart_, fill_, cellOf_, items_;
+};
+
+class TrackManager {
+public:
+    explicit TrackManager(TrackManagerConfig cfg = TrackManagerConfig()) : cfg_(cfg) {}
+
+    // Advances every track one frame and returns the regions to search:
+    // the whole frame when looking for new targets, otherwise one padded
+    // window per track (overlapping windows merged so no blob is seen twice).
+    const std::vector<cv::Rect>& predict(cv::Size frameSize) {
+        frameSize_ = frameSize;
+        cv::Rect full(0, 0, frameSize.width, frameSize.height);
+        for (size_t i = 0; i < tracks_.size(); i++) tracks_[i].predicted = models_[i].predict();
+
+        std::vector<cv::Rect>& windows = windows_;
+        windows.clear();
+        bool anyVisible = std::any_of(tracks_.begin(), tracks_.end(), [](const Track& t) { return t.visible(); });
+        bool tentative = std::any_of(tracks_.begin(), tracks_.end(),
+                                     [](const Track& t) { return t.state == TrackState::TENTATIVE; });
+        if (!anyVisible || tentative || ++sinceFullSearch_ >= cfg_.fullSearchInterval) {
+            sinceFullSearch_ = 0;
+            windows.push_back(full);
+            return windows;
+        }
+
+        // Kept windows stay pairwise disjoint. A new one absorbs every kept
+        // window it overlaps, rescanning after each since it grew; every
+        // absorption removes a window, so this is O(n^2) overall.
+        for (const Track& t : tracks_) {
+            int w = t.box.width + 2 * cfg_.padding, h = t.box.height + 2 * cfg_.padding;
+            cv::Rect r((int)t.predicted.x - w / 2, (int)t.predicted.y - h / 2, w, h);
+            r &= full;
+            if (r.empty()) continue;
+            for (size_t k = 0; k < windows.size();) {
+                if ((windows[k] & r).area() > 0) {
+                    r |= windows[k];
+                    windows[k] = windows.back();
+                    windows.pop_back();
+                    k = 0;
+                } else {
+                    k++;
+                }
+            }
+            windows.push_back(r);
+        }
+        return windows;
+    }
+
+    // Associates this frame's detections (frame coordinates) with the tracks.
+    // With 'classes' (one class ID per detection) a detection only continues
+    // a track of its own class.
+    void update(const std::vector<cv::Rect>& detections, const std::vector<int>& classes = std::vector<int>()) {
+        centres_.resize(detections.size());
+        for (size_t i = 0; i < detections.size(); i++)
+            centres_[i] = cv::Point2f(detections[i].x + detections[i].width / 2.f,
+                                      detections[i].y + detections[i].height / 2.f);
+        grid_.build(centres_, frameSize_, cfg_.gate);
+
+        // Candidate pairs inside the gate, best first.
+        pairs_.clear();
+        const float gate2 = cfg_.gate * cfg_.gate;
+        for (size_t ti = 0; ti < tracks_.size(); ti++) {
+            cv::Point2f p = tracks_[ti].predicted;
+            grid_.forNeighbours(p, [&](int di) {
+                cv::Point2f d = centres_[di] - p;
+                float d2 = d.x * d.x + d.y * d.y;
+                if (!classes.empty() && classes[di] != tracks_[ti].cls) return;
+                if (d2 <= gate2) pairs_.push_back({d2, (int)ti, di});
+            });
+        }
+        std::sort(pairs_.begin(), pairs_.end(), [](const Pair& a, const Pair& b) { return a.d2 < b.d2; });
+
+        trackUsed_.assign(tracks_.size(), 0);
+        detUsed_.assign(detections.size(), 0);
+        for (const Pair& p : pairs_) {
+            if (trackUsed_[p.track] || detUsed_[p.det]) continue;
+            trackUsed_[p.track] = detUsed_[p.det] = 1;
+            hit(tracks_[p.track], models_[p.track], detections[p.det], centres_[p.det]);
+        }
+
+        for (size_t ti = 0; ti < trackUsed_.size(); ti++)
+            if (!trackUsed_[ti]) miss(tracks_[ti]);
+
+        for (size_t di = 0; di < detections.size(); di++) {
+            if (detUsed_[di]) continue;
+            Track t;
+            t.id = nextId_++;
+            t.box = detections[di];
+            t.hits = 1;
+            t.cls = classes.empty() ? 0 : classes[di];
+            if (cfg_.confirmHits <= 1) t.state = TrackState::CONFIRMED;
+            tracks_.push_back(t);
+            models_.emplace_back();
+            models_.back().init(centres_[di]);
+        }
+
+        size_t kept = 0;
+        for (size_t i = 0; i < tracks_.size(); i++) {
+            if (tracks_[i].state == TrackState::DELETED) continue;
+            if (kept != i) {
+                tracks_[kept] = tracks_[i];
+                std::swap(models_[kept], models_[i]);
+            }
+            kept++;
+        }
+        tracks_.resize(kept);
+        models_.resize(kept);
+        if (!engaged()) engageLargest();
+    }
+
+    const std::vector<Track>& tracks() const { return tracks_; }
+
+    // Track the weapons are assigned to, or nullptr.
+    const Track* engaged() const {
+        for (const Track& t : tracks_)
+            if (t.id == engagedId_ && t.visible()) return &t;
+        return nullptr;
+    }
+
+    // Moves the engagement to the next visible track in ID order.
+    void cycleEngaged() {
+        const Track* next = nullptr;
+        const Track* first = nullptr;
+        for (const Track& t : tracks_) {
+            if (!t.visible()) continue;
+            if (!first || t.id < first->id) first = &t;
+            if (t.id > engagedId_ && (!next || t.id < next->id)) next = &t;
+        }
+        if (!next) next = first;
+        engagedId_ = next ? next->id : -1;
+    }
+
+private:
+    struct Pair {
+        float d2;
+        int track, det;
+    };
+
+    void hit(Track& t, MotionModel& model, const cv::Rect& det, cv::Point2f c) {
+        c = model.correct(c);
+        t.box = cv::Rect((int)(c.x - det.width / 2.f), (int)(c.y - det.height / 2.f), det.width, det.height);
+        t.hits++;
+        t.misses = 0;
+        if (t.state != TrackState::TENTATIVE || t.hits >= cfg_.confirmHits) t.state = TrackState::CONFIRMED;
+    }
+
+    void miss(Track& t) {
+        t.misses++;
+        t.box.x = (int)(t.predicted.x - t.box.width / 2.f);
+        t.box.y = (int)(t.predicted.y - t.box.height / 2.f);
+        if (t.state == TrackState::TENTATIVE) {
+            if (t.misses > cfg_.tentativeMisses) t.state = TrackState::DELETED;
+        } else if (t.misses > cfg_.maxMisses) {
+            t.state = TrackState::DELETED;
+        } else {
+            t.state = TrackState::COASTING;
+        }
+    }
+
+    void engageLargest() {
+        engagedId_ = -1;
+        int best = 0;
+        for (const Track& t : tracks_)
+            if (t.visible() && t.box.area() > best) { best = t.box.area(); engagedId_ = t.id; }
+    }
+
+    TrackManagerConfig cfg_;
+    std::vector<Track> tracks_;
+    std::vector<MotionModel> models_;   // parallel to tracks_, so Track stays a plain value
+    int nextId_ = 1;
+    int engagedId_ = -1;
+    int sinceFullSearch_ = 0;
+    cv::Size frameSize_;
+
+    SpatialGrid grid_;
+    std::vector<cv::Point2f> centres_;
+    std::vector<Pair> pairs_;
+    std::vector<cv::Rect> windows_;
+    std::vector<char> trackUsed_, detUsed_;
+};
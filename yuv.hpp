@@ -0,0 +1,118 @@
+#pragma once
+
+// Detection straight on the camera's YUV frames. Webcams and recordings
+// deliver YUYV or NV12; letting VideoCapture turn that into BGR and then
+// converting BGR to HSV costs two full-frame colour conversions before the
+// threshold even starts. Here every 2x2 block is classified once, from its
+// chroma sample and mean luma, so the mask has half the resolution in each
+// axis (a quarter of the pixels) and BGR is only made for display.
+
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <cstdint>
+#include "bitmask.hpp"
+#include "threshold.hpp"
+
+// NV12: CV_8UC1 with height * 3 / 2 rows, the Y plane followed by
+// interleaved U/V at half resolution. YUYV: CV_8UC2, Y0 U Y1 V per pixel pair.
+enum class YuvFormat { NV12, YUYV };
+
+inline cv::Size yuvFrameSize(const cv::Mat& yuv, YuvFormat format) {
+    return format == YuvFormat::NV12 ? cv::Size(yuv.cols, yuv.rows * 2 / 3) : yuv.size();
+}
+
+// Size of the chroma grid the mask is computed on.
+inline cv::Size yuvChromaSize(const cv::Mat& yuv, YuvFormat format) {
+    cv::Size s = yuvFrameSize(yuv, format);
+    return cv::Size(s.width / 2, s.height / 2);
+}
+
+inline int yuvToBgrCode(YuvFormat format) {
+    return format == YuvFormat::NV12 ? cv::COLOR_YUV2BGR_NV12 : cv::COLOR_YUV2BGR_YUYV;
+}
+
+// Frame rectangle -> the chroma blocks covering it, and back.
+inline cv::Rect toChroma(const cv::Rect& r, cv::Size chroma) {
+    cv::Rect c(r.x / 2, r.y / 2, (r.x + r.width + 1) / 2 - r.x / 2, (r.y + r.height + 1) / 2 - r.y / 2);
+    return c & cv::Rect(cv::Point(), chroma);
+}
+
+inline cv::Rect fromChroma(const cv::Rect& r) {
+    return cv::Rect(r.x * 2, r.y * 2, r.width * 2, r.height * 2);
+}
+
+// BT.601 video range, the fixed-point coefficients of cvtColor(COLOR_YUV2BGR_*).
+inline void yuvToBgrPixel(int y, int u, int v, uchar* bgr) {
+    const int half = 1 << 19;
+    int c = std::max(0, y - 16) * 1220542;
+    u -= 128;
+    v -= 128;
+    bgr[0] = cv::saturate_cast<uchar>((c + 2116026 * u + half) >> 20);
+    bgr[1] = cv::saturate_cast<uchar>((c - 409993 * u - 852492 * v + half) >> 20);
+    bgr[2] = cv::saturate_cast<uchar>((c + 1673527 * v + half) >> 20);
+}
+
+// n blocks of two NV12 luma rows and their chroma row -> n BGR pixels.
+inline void nv12Blocks(const uchar* y0, const uchar* y1, const uchar* uv, uchar* bgr, int n) {
+    for (int x = 0; x < n; x++, y0 += 2, y1 += 2, uv += 2, bgr += 3)
+        yuvToBgrPixel((y0[0] + y0[1] + y1[0] + y1[1] + 2) >> 2, uv[0], uv[1], bgr);
+}
+
+// Same for two YUYV rows; each row has its own chroma, which is averaged.
+inline void yuyvBlocks(const uchar* r0, const uchar* r1, uchar* bgr, int n) {
+    for (int x = 0; x < n; x++, r0 += 4, r1 += 4, bgr += 3)
+        yuvToBgrPixel((r0[0] + r0[2] + r1[0] + r1[2] + 2) >> 2, (r0[1] + r1[1] + 1) >> 1, (r0[3] + r1[3] + 1) >> 1, bgr);
+}
+
+// HSV band mask of the chroma blocks in 'window' (chroma coordinates): bit
+// (x, y) of the mask covers frame pixels 2 (window.x + x) .. + 1 and
+// 2 (window.y + y) .. + 1. Each chunk of blocks is turned into BGR in a
+// small buffer and run through the same HSV kernel as bgrToMask.
+inline void yuvToMask(const cv::Mat& yuv, YuvFormat format, cv::Rect window,
+                      const cv::Scalar& lower, const cv::Scalar& upper, BitMask& mask) {
+    CV_Assert(yuv.type() == (format == YuvFormat::NV12 ? CV_8UC1 : CV_8UC2));
+    window &= cv::Rect(cv::Point(), yuvChromaSize(yuv, format));
+    mask.create(window.height, window.width);
+    HsvBand band(lower, upper);
+    if (band.empty || window.empty()) {
+        mask.clear();
+        return;
+    }
+    static const BgrToMaskRowFn kernel = bgrToMaskRowKernel();
+    int uvRow = yuvFrameSize(yuv, format).height;
+    cv::parallel_for_(cv::Range(0, window.height), [&](const cv::Range& rows) {
+        uchar bgr[3 * 256], chunk[256];
+        for (int y = rows.start; y < rows.end; y++) {
+            int cy = window.y + y;
+            const uchar* y0 = yuv.ptr<uchar>(2 * cy);
+            const uchar* y1 = yuv.ptr<uchar>(2 * cy + 1);
+            uint64_t* dst = mask.row(y);
+            for (int x = 0; x < window.width; x += 256) {
+                int n = std::min(256, window.width - x), cx = window.x + x;
+                if (format == YuvFormat::NV12)
+                    nv12Blocks(y0 + 2 * cx, y1 + 2 * cx, yuv.ptr<uchar>(uvRow + cy) + 2 * cx, bgr, n);
+                else
+                    yuyvBlocks(y0 + 4 * cx, y1 + 4 * cx, bgr, n);
+                kernel(bgr, chunk, n, band);
+                packBits(chunk, n, dst + x / 64);
+            }
+        }
+    }, window.area() / (double)(1 << 14));
+}
+
+// BGR -> NV12, for the benchmark and for writing raw test clips.
+inline void bgrToNv12(const cv::Mat& bgr, cv::Mat& nv12) {
+    CV_Assert(bgr.type() == CV_8UC3 && bgr.cols % 2 == 0 && bgr.rows % 2 == 0);
+    cv::Mat i420;
+    cv::cvtColor(bgr, i420, cv::COLOR_BGR2YUV_I420);
+    int w = bgr.cols, h = bgr.rows;
+    nv12.create(h * 3 / 2, w, CV_8UC1);
+    i420.rowRange(0, h).copyTo(nv12.rowRange(0, h));
+    const uchar* u = i420.ptr<uchar>(h);
+    const uchar* v = u + (w / 2) * (h / 2);
+    uchar* uv = nv12.ptr<uchar>(h);
+    for (int i = 0; i < (w / 2) * (h / 2); i++) {
+        uv[2 * i] = u[i];
+        uv[2 * i + 1] = v[i];
+    }
+}